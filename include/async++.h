@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
@@ -35,6 +36,7 @@
 #include <mutex>
 #include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -113,6 +115,19 @@
 # define LIBASYNC_CACHELINE_ALIGN alignas(LIBASYNC_CACHELINE_SIZE)
 #endif
 
+// Static tracepoints (USDT) for tools like bpftrace and SystemTap, enabled if
+// the library was built with USE_USDT_PROBES and sys/sdt.h is available. Each
+// probe compiles to a single NOP until a tracer attaches to it. All probes
+// use the "async" provider name.
+#ifdef LIBASYNC_USDT_PROBES
+# include <sys/sdt.h>
+# define LIBASYNC_PROBE1(name, a) DTRACE_PROBE1(async, name, a)
+# define LIBASYNC_PROBE2(name, a, b) DTRACE_PROBE2(async, name, a, b)
+#else
+# define LIBASYNC_PROBE1(name, a) do {} while (false)
+# define LIBASYNC_PROBE2(name, a, b) do {} while (false)
+#endif
+
 // Force symbol visibility to hidden unless explicity exported
 #ifndef LIBASYNC_STATIC
 #if defined(__GNUC__) && !defined(_WIN32)
@@ -145,9 +160,21 @@ class event_task;
 #include "async++/cancel.h"
 #include "async++/range.h"
 #include "async++/partitioner.h"
+#include "async++/blocked_range.h"
 #include "async++/parallel_invoke.h"
 #include "async++/parallel_for.h"
 #include "async++/parallel_reduce.h"
+#include "async++/parallel_transform.h"
+#include "async++/parallel_merge.h"
+#include "async++/parallel_sort.h"
+#include "async++/parallel_numeric.h"
+#include "async++/parallel_copy.h"
+#include "async++/parallel_do.h"
+#include "async++/parallel_find.h"
+#include "async++/parallel_filter.h"
+#include "async++/combinable.h"
+#include "async++/parallel_histogram.h"
+#include "async++/execution.h"
 
 #ifndef LIBASYNC_STATIC
 #if defined(__GNUC__) && !defined(_WIN32)
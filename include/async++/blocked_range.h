@@ -0,0 +1,218 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// One dimension of a blocked range: a half-open interval of integers and the
+// grain size below which it is not split any further.
+template<typename T>
+struct blocked_dimension {
+	T value_begin, value_end;
+	std::size_t grain;
+
+	static_assert(std::is_integral<T>::value, "Blocked ranges can only be used with integral types");
+
+	std::size_t size() const
+	{
+		return value_begin < value_end ? static_cast<std::size_t>(value_end - value_begin) : 0;
+	}
+	bool splittable() const
+	{
+		return size() > grain;
+	}
+
+	// Split the dimension in half, keeping the first half and returning the
+	// second one.
+	blocked_dimension split()
+	{
+		blocked_dimension out = *this;
+		value_end = static_cast<T>(value_begin + (size() + 1) / 2);
+		out.value_begin = value_end;
+		return out;
+	}
+};
+
+// Choose a grain size for one dimension of a blocked range so that the total
+// number of blocks is roughly the same as what auto_grain_size would produce
+// for a one-dimensional range.
+inline std::size_t auto_block_grain_size(std::size_t dist, std::size_t dimensions)
+{
+	// Number of blocks along each dimension
+	std::size_t blocks = 1;
+	std::size_t target = 8 * hardware_concurrency();
+	while (true) {
+		std::size_t total = 1;
+		for (std::size_t i = 0; i < dimensions; i++)
+			total *= blocks + 1;
+		if (total > target)
+			break;
+		blocks++;
+	}
+
+	std::size_t grain = (dist + blocks - 1) / blocks;
+	return grain < 1 ? 1 : grain;
+}
+
+} // namespace detail
+
+// Two-dimensional range of integers which is split into rectangular blocks for
+// cache locality. Blocked ranges are partitioners: split() divides the
+// dimension which is largest relative to its grain size, so blocks stay close
+// to the requested shape. Since a block has no elements to iterate over,
+// parallel_for and parallel_map_reduce pass each block to the user function as
+// a blocked_range2d, like the chunk-level algorithms (parallel_for_chunked and
+// parallel_map_reduce_chunked) do. A reduction over a blocked range needs a map
+// function which computes the result for one block, so parallel_reduce, which
+// has no map step, is not supported.
+template<typename RowValue, typename ColValue = RowValue>
+class blocked_range2d {
+	detail::blocked_dimension<RowValue> row_dim;
+	detail::blocked_dimension<ColValue> col_dim;
+
+public:
+	blocked_range2d(RowValue row_begin, RowValue row_end, std::size_t row_grain, ColValue col_begin, ColValue col_end, std::size_t col_grain)
+		: row_dim{row_begin, row_end, row_grain}, col_dim{col_begin, col_end, col_grain} {}
+
+	// Choose grain sizes automatically
+	blocked_range2d(RowValue row_begin, RowValue row_end, ColValue col_begin, ColValue col_end)
+		: row_dim{row_begin, row_end, 1}, col_dim{col_begin, col_end, 1}
+	{
+		row_dim.grain = detail::auto_block_grain_size(row_dim.size(), 2);
+		col_dim.grain = detail::auto_block_grain_size(col_dim.size(), 2);
+	}
+
+	int_range<RowValue> rows() const
+	{
+		return {row_dim.value_begin, row_dim.value_end};
+	}
+	int_range<ColValue> cols() const
+	{
+		return {col_dim.value_begin, col_dim.value_end};
+	}
+	bool empty() const
+	{
+		return row_dim.size() == 0 || col_dim.size() == 0;
+	}
+
+	blocked_range2d split()
+	{
+		// Don't split if both dimensions are below their grain size
+		blocked_range2d out = *this;
+		bool split_rows = row_dim.splittable() && (!col_dim.splittable() || row_dim.size() * col_dim.grain >= col_dim.size() * row_dim.grain);
+		if (split_rows)
+			out.row_dim = row_dim.split();
+		else if (col_dim.splittable())
+			out.col_dim = col_dim.split();
+		else
+			out.row_dim.value_begin = out.row_dim.value_end;
+		return out;
+	}
+};
+
+// Three-dimensional equivalent of blocked_range2d
+template<typename PageValue, typename RowValue = PageValue, typename ColValue = RowValue>
+class blocked_range3d {
+	detail::blocked_dimension<PageValue> page_dim;
+	detail::blocked_dimension<RowValue> row_dim;
+	detail::blocked_dimension<ColValue> col_dim;
+
+public:
+	blocked_range3d(PageValue page_begin, PageValue page_end, std::size_t page_grain, RowValue row_begin, RowValue row_end, std::size_t row_grain, ColValue col_begin, ColValue col_end, std::size_t col_grain)
+		: page_dim{page_begin, page_end, page_grain}, row_dim{row_begin, row_end, row_grain}, col_dim{col_begin, col_end, col_grain} {}
+
+	// Choose grain sizes automatically
+	blocked_range3d(PageValue page_begin, PageValue page_end, RowValue row_begin, RowValue row_end, ColValue col_begin, ColValue col_end)
+		: page_dim{page_begin, page_end, 1}, row_dim{row_begin, row_end, 1}, col_dim{col_begin, col_end, 1}
+	{
+		page_dim.grain = detail::auto_block_grain_size(page_dim.size(), 3);
+		row_dim.grain = detail::auto_block_grain_size(row_dim.size(), 3);
+		col_dim.grain = detail::auto_block_grain_size(col_dim.size(), 3);
+	}
+
+	int_range<PageValue> pages() const
+	{
+		return {page_dim.value_begin, page_dim.value_end};
+	}
+	int_range<RowValue> rows() const
+	{
+		return {row_dim.value_begin, row_dim.value_end};
+	}
+	int_range<ColValue> cols() const
+	{
+		return {col_dim.value_begin, col_dim.value_end};
+	}
+	bool empty() const
+	{
+		return page_dim.size() == 0 || row_dim.size() == 0 || col_dim.size() == 0;
+	}
+
+	blocked_range3d split()
+	{
+		// Pick the splittable dimension with the largest size relative to its
+		// grain size, preferring outer dimensions on ties.
+		blocked_range3d out = *this;
+		bool split_pages = page_dim.splittable() &&
+			(!row_dim.splittable() || page_dim.size() * row_dim.grain >= row_dim.size() * page_dim.grain) &&
+			(!col_dim.splittable() || page_dim.size() * col_dim.grain >= col_dim.size() * page_dim.grain);
+		bool split_rows = !split_pages && row_dim.splittable() &&
+			(!col_dim.splittable() || row_dim.size() * col_dim.grain >= col_dim.size() * row_dim.grain);
+		if (split_pages)
+			out.page_dim = page_dim.split();
+		else if (split_rows)
+			out.row_dim = row_dim.split();
+		else if (col_dim.splittable())
+			out.col_dim = col_dim.split();
+		else
+			out.page_dim.value_begin = out.page_dim.value_end;
+		return out;
+	}
+};
+
+namespace detail {
+
+// Blocked ranges are passed to chunk-level functions as-is
+template<typename RowValue, typename ColValue>
+bool partition_empty(const blocked_range2d<RowValue, ColValue>& p)
+{
+	return p.empty();
+}
+template<typename RowValue, typename ColValue>
+blocked_range2d<RowValue, ColValue> partition_chunk(const blocked_range2d<RowValue, ColValue>& p)
+{
+	return p;
+}
+template<typename PageValue, typename RowValue, typename ColValue>
+bool partition_empty(const blocked_range3d<PageValue, RowValue, ColValue>& p)
+{
+	return p.empty();
+}
+template<typename PageValue, typename RowValue, typename ColValue>
+blocked_range3d<PageValue, RowValue, ColValue> partition_chunk(const blocked_range3d<PageValue, RowValue, ColValue>& p)
+{
+	return p;
+}
+
+} // namespace detail
+} // namespace async
@@ -0,0 +1,203 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Storage for the instance of a combinable value belonging to one thread. Each
+// instance is placed in its own cache line to avoid false sharing.
+template<typename T>
+struct LIBASYNC_CACHELINE_ALIGN combinable_slot {
+	T value;
+
+	explicit combinable_slot(T&& value_)
+		: value(std::move(value_)) {}
+
+	// Use aligned memory allocation
+	static void* operator new(std::size_t size)
+	{
+		return aligned_alloc(size, LIBASYNC_CACHELINE_SIZE);
+	}
+	static void operator delete(void* ptr)
+	{
+		aligned_free(ptr);
+	}
+};
+
+} // namespace detail
+
+// Container holding one instance of T for each thread that uses it. Instances
+// are created lazily the first time a thread calls local(), using the
+// initialization function, and can then be combined into a single value once
+// the parallel work is done. This allows a reduction to use one instance per
+// worker thread instead of one per chunk, which matters when T is expensive to
+// copy or merge (histograms, hash maps, ...):
+//
+// async::combinable<std::vector<int>> hist([] { return std::vector<int>(256); });
+// async::parallel_for(data, [&](unsigned char c) { hist.local()[c]++; });
+// hist.combine_each([&](const std::vector<int>& h) { ... });
+//
+// Worker threads of the first thread pool to use the object find their
+// instance directly by thread index, without any locking. Other threads fall
+// back to a lookup by thread id protected by a mutex.
+//
+// combine(), combine_each() and clear() must not be called while other threads
+// are still using the object.
+template<typename T>
+class combinable {
+	typedef detail::combinable_slot<T> slot;
+
+	std::function<T()> init_func;
+
+	// Instances for the workers of the thread pool that owns this object,
+	// indexed by thread index. Each slot is only accessed by its own worker.
+	std::atomic<detail::threadpool_data*> owner;
+	std::unique_ptr<std::unique_ptr<slot>[]> worker_slots;
+	std::size_t num_worker_slots;
+
+	// Instances for all other threads, protected by the lock
+	std::mutex lock;
+	std::vector<std::pair<std::thread::id, std::unique_ptr<slot>>> other_slots;
+
+	// Try to make the given thread pool the owner of this object
+	bool claim(detail::threadpool_data* pool)
+	{
+		std::lock_guard<std::mutex> locked(lock);
+		detail::threadpool_data* current = owner.load(std::memory_order_relaxed);
+		if (current)
+			return current == pool;
+		num_worker_slots = detail::threadpool_num_threads(pool);
+		worker_slots.reset(new std::unique_ptr<slot>[num_worker_slots]);
+		owner.store(pool, std::memory_order_release);
+		return true;
+	}
+
+	T& local_other(bool& exists)
+	{
+		std::thread::id id = std::this_thread::get_id();
+		std::lock_guard<std::mutex> locked(lock);
+		for (auto& i: other_slots) {
+			if (i.first == id) {
+				exists = true;
+				return i.second->value;
+			}
+		}
+		exists = false;
+		other_slots.emplace_back(id, std::unique_ptr<slot>(new slot(init_func())));
+		return other_slots.back().second->value;
+	}
+
+	// Call a function on every existing instance
+	template<typename Func>
+	void for_each_slot(const Func& func) const
+	{
+		for (std::size_t i = 0; i < num_worker_slots; i++) {
+			if (worker_slots[i])
+				func(static_cast<const T&>(worker_slots[i]->value));
+		}
+		for (auto& i: other_slots)
+			func(static_cast<const T&>(i.second->value));
+	}
+	template<typename Func>
+	void for_each_slot(const Func& func)
+	{
+		for (std::size_t i = 0; i < num_worker_slots; i++) {
+			if (worker_slots[i])
+				func(worker_slots[i]->value);
+		}
+		for (auto& i: other_slots)
+			func(i.second->value);
+	}
+
+public:
+	// Instances are value-initialized by default
+	combinable()
+		: init_func([] { return T(); }), owner(nullptr), num_worker_slots(0) {}
+	template<typename Func>
+	explicit combinable(Func&& init)
+		: init_func(std::forward<Func>(init)), owner(nullptr), num_worker_slots(0) {}
+
+	// Get the instance for the current thread, and set exists to whether it
+	// had already been created before this call.
+	T& local(bool& exists)
+	{
+		std::size_t index = detail::current_thread_index();
+		if (index != detail::invalid_thread_index) {
+			detail::threadpool_data* pool = detail::current_threadpool();
+			if ((owner.load(std::memory_order_acquire) == pool || claim(pool)) && index < num_worker_slots) {
+				std::unique_ptr<slot>& s = worker_slots[index];
+				exists = static_cast<bool>(s);
+				if (!exists)
+					s.reset(new slot(init_func()));
+				return s->value;
+			}
+		}
+		return local_other(exists);
+	}
+	T& local()
+	{
+		bool exists;
+		return local(exists);
+	}
+
+	// Combine all instances using a binary function. If no thread has created
+	// an instance then a new one is returned from the initialization function.
+	template<typename Func>
+	T combine(const Func& func) const
+	{
+		std::unique_ptr<T> out;
+		for_each_slot([&out, &func](const T& value) {
+			if (out)
+				*out = func(std::move(*out), value);
+			else
+				out.reset(new T(value));
+		});
+		return out ? std::move(*out) : init_func();
+	}
+
+	// Call a function on every instance, in an unspecified order. The non-const
+	// version allows the instances to be modified, for example to move their
+	// contents out.
+	template<typename Func>
+	void combine_each(const Func& func) const
+	{
+		for_each_slot(func);
+	}
+	template<typename Func>
+	void combine_each(const Func& func)
+	{
+		for_each_slot(func);
+	}
+
+	// Destroy all instances
+	void clear()
+	{
+		worker_slots.reset();
+		num_worker_slots = 0;
+		other_slots.clear();
+		owner.store(nullptr, std::memory_order_relaxed);
+	}
+};
+
+} // namespace async
@@ -0,0 +1,436 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace execution {
+
+// Execution policy which runs algorithms on a specific scheduler. This is
+// normally created with par_on(), and holds a reference to the scheduler.
+template<typename Sched>
+class parallel_policy {
+	Sched* sched_ptr;
+
+public:
+	explicit parallel_policy(Sched& sched)
+		: sched_ptr(&sched) {}
+
+	Sched& scheduler() const
+	{
+		return *sched_ptr;
+	}
+};
+
+// Execution policy which runs algorithms on the default scheduler
+struct default_parallel_policy {
+	detail::default_scheduler_type& scheduler() const
+	{
+		return ::async::default_scheduler();
+	}
+};
+const default_parallel_policy par = {};
+
+// Create a policy which runs algorithms on the given scheduler
+template<typename Sched>
+parallel_policy<Sched> par_on(Sched& sched)
+{
+	static_assert(detail::is_scheduler<Sched>::value, "par_on requires a scheduler");
+	return parallel_policy<Sched>(sched);
+}
+
+// Check whether a type is one of the execution policies above
+template<typename T>
+struct is_execution_policy: public std::false_type {};
+template<typename Sched>
+struct is_execution_policy<parallel_policy<Sched>>: public std::true_type {};
+template<>
+struct is_execution_policy<default_parallel_policy>: public std::true_type {};
+
+} // namespace execution
+
+namespace detail {
+
+// Enable an algorithm overload only when the first argument is a policy
+template<typename Policy, typename Result = void>
+struct enable_if_policy: public std::enable_if<execution::is_execution_policy<typename std::decay<Policy>::type>::value, Result> {};
+
+// Partial result of a reduction without an identity value. Empty chunks
+// produce an empty result, which is skipped when partial results are
+// combined. The value is stored inline so that combining partial results
+// doesn't allocate, and T doesn't need to be default-constructible.
+template<typename T>
+class partial_result {
+	bool valid;
+	union {
+		T value;
+	};
+
+public:
+	partial_result()
+		: valid(false) {}
+	explicit partial_result(T&& value_)
+		: valid(true)
+	{
+		new(&value) T(std::move(value_));
+	}
+	partial_result(partial_result&& other)
+		: valid(other.valid)
+	{
+		if (valid)
+			new(&value) T(std::move(other.value));
+	}
+	partial_result(const partial_result& other)
+		: valid(other.valid)
+	{
+		if (valid)
+			new(&value) T(other.value);
+	}
+	partial_result& operator=(partial_result other)
+	{
+		if (valid && other.valid) {
+			value = std::move(other.value);
+			return *this;
+		}
+
+		// Only mark the value as valid once it has been constructed, in case
+		// the move constructor throws.
+		if (valid) {
+			valid = false;
+			value.~T();
+		}
+		if (other.valid) {
+			new(&value) T(std::move(other.value));
+			valid = true;
+		}
+		return *this;
+	}
+	~partial_result()
+	{
+		if (valid)
+			value.~T();
+	}
+
+	explicit operator bool() const
+	{
+		return valid;
+	}
+	T& operator*()
+	{
+		return value;
+	}
+};
+
+// Reduce a chunk of elements after applying a transform to each of them. This
+// is used as the map function of parallel_map_reduce_chunked. For binary
+// transforms the matching element of the second range is found from the
+// offset of the chunk, which is why both ranges must be random-access.
+template<typename T, typename Reduce, typename Transform>
+struct unary_transform_reduce_leaf {
+	const Reduce& reduce;
+	const Transform& transform;
+
+	template<typename Chunk>
+	partial_result<T> operator()(const Chunk& chunk, partial_result<T> out) const
+	{
+		auto it = chunk.begin();
+		if (it == chunk.end())
+			return out;
+		T acc = transform(*it);
+		for (++it; it != chunk.end(); ++it)
+			acc = reduce(std::move(acc), transform(*it));
+		if (out)
+			return partial_result<T>(reduce(std::move(*out), std::move(acc)));
+		return partial_result<T>(std::move(acc));
+	}
+};
+template<typename T, typename Iter1, typename Iter2, typename Reduce, typename Transform>
+struct binary_transform_reduce_leaf {
+	Iter1 base1;
+	Iter2 base2;
+	const Reduce& reduce;
+	const Transform& transform;
+
+	template<typename Chunk>
+	partial_result<T> operator()(const Chunk& chunk, partial_result<T> out) const
+	{
+		auto it = chunk.begin();
+		if (it == chunk.end())
+			return out;
+		Iter2 it2 = base2;
+		std::advance(it2, std::distance(base1, it));
+		T acc = transform(*it, *it2);
+		for (++it, ++it2; it != chunk.end(); ++it, ++it2)
+			acc = reduce(std::move(acc), transform(*it, *it2));
+		if (out)
+			return partial_result<T>(reduce(std::move(*out), std::move(acc)));
+		return partial_result<T>(std::move(acc));
+	}
+};
+
+// Combine two partial results
+template<typename T, typename Reduce>
+struct partial_reduce {
+	const Reduce& reduce;
+
+	partial_result<T> operator()(partial_result<T> a, partial_result<T> b) const
+	{
+		if (!a)
+			return b;
+		if (!b)
+			return a;
+		return partial_result<T>(reduce(std::move(*a), std::move(*b)));
+	}
+};
+
+// Combine the initial value with the result of a reduction
+template<typename T, typename Reduce>
+T finish_reduce(T init, partial_result<T> result, const Reduce& reduce)
+{
+	if (!result)
+		return init;
+	return reduce(std::move(init), std::move(*result));
+}
+
+// Copy and fill use the memory routines of parallel_copy.h for contiguous
+// arrays of trivially copyable elements, and element-wise loops otherwise.
+template<typename Iter, typename OutIter>
+struct is_memory_copyable: public std::integral_constant<bool, is_contiguous_iterator<Iter>::value && is_contiguous_iterator<OutIter>::value &&
+	std::is_same<typename std::iterator_traits<Iter>::value_type, typename std::iterator_traits<OutIter>::value_type>::value &&
+	std::is_trivially_copyable<typename std::iterator_traits<Iter>::value_type>::value> {};
+
+template<typename Sched, typename Iter, typename OutIter>
+OutIter policy_copy(Sched& sched, Iter first, Iter last, OutIter out, std::true_type)
+{
+	return async::parallel_copy(sched, async::make_range(first, last), out);
+}
+template<typename Sched, typename Iter, typename OutIter>
+OutIter policy_copy(Sched& sched, Iter first, Iter last, OutIter out, std::false_type)
+{
+	return async::parallel_transform(sched, async::make_range(first, last), out, default_map());
+}
+template<typename Sched, typename Iter, typename T>
+void policy_fill(Sched& sched, Iter first, Iter last, const T& value, std::true_type)
+{
+	async::parallel_fill(sched, async::make_range(first, last), value);
+}
+template<typename Sched, typename Iter, typename T>
+void policy_fill(Sched& sched, Iter first, Iter last, const T& value, std::false_type)
+{
+	async::parallel_for(sched, async::make_range(first, last), [&value](typename std::iterator_traits<Iter>::reference x) {
+		x = value;
+	});
+}
+
+} // namespace detail
+
+// Parallel versions of the standard algorithms which take an execution policy
+// as their first argument, like the C++17 overloads in namespace std:
+//
+// async::sort(async::execution::par_on(sched), v.begin(), v.end());
+//
+// These are built on the parallel algorithms of this library, so they run on
+// the same work-stealing pool as the rest of the program. Some algorithms
+// require random-access iterators where the standard accepts forward
+// iterators, which is checked at compile time.
+
+template<typename Policy, typename Iter, typename Func>
+typename detail::enable_if_policy<Policy>::type for_each(const Policy& policy, Iter first, Iter last, const Func& func)
+{
+	async::parallel_for(policy.scheduler(), async::make_range(first, last), func);
+}
+template<typename Policy, typename Iter, typename Size, typename Func>
+typename detail::enable_if_policy<Policy, Iter>::type for_each_n(const Policy& policy, Iter first, Size n, const Func& func)
+{
+	Iter last = std::next(first, n);
+	async::parallel_for(policy.scheduler(), async::make_range(first, last), func);
+	return last;
+}
+
+template<typename Policy, typename Iter, typename OutIter, typename Func>
+typename detail::enable_if_policy<Policy, OutIter>::type transform(const Policy& policy, Iter first, Iter last, OutIter out, const Func& func)
+{
+	return async::parallel_transform(policy.scheduler(), async::make_range(first, last), out, func);
+}
+template<typename Policy, typename Iter1, typename Iter2, typename OutIter, typename Func>
+typename detail::enable_if_policy<Policy, OutIter>::type transform(const Policy& policy, Iter1 first1, Iter1 last1, Iter2 first2, OutIter out, const Func& func)
+{
+	return async::parallel_transform(policy.scheduler(), async::make_range(first1, last1), first2, out, func);
+}
+
+// Unlike parallel_reduce, the initial value is only used once, so it doesn't
+// need to be an identity value of the reduction.
+template<typename Policy, typename Iter, typename T, typename Reduce, typename Transform>
+typename detail::enable_if_policy<Policy, T>::type transform_reduce(const Policy& policy, Iter first, Iter last, T init, const Reduce& reduce, const Transform& transform)
+{
+	detail::partial_result<T> result = async::parallel_map_reduce_chunked(policy.scheduler(), async::make_range(first, last), detail::partial_result<T>(), detail::unary_transform_reduce_leaf<T, Reduce, Transform>{reduce, transform}, detail::partial_reduce<T, Reduce>{reduce});
+	return detail::finish_reduce(std::move(init), std::move(result), reduce);
+}
+
+// The binary forms require random-access iterators, since each chunk has to
+// find the matching position in the second range.
+template<typename Policy, typename Iter1, typename Iter2, typename T, typename Reduce, typename Transform>
+typename detail::enable_if_policy<Policy, T>::type transform_reduce(const Policy& policy, Iter1 first1, Iter1 last1, Iter2 first2, T init, const Reduce& reduce, const Transform& transform)
+{
+	static_assert(std::is_same<typename std::iterator_traits<Iter1>::iterator_category, std::random_access_iterator_tag>::value, "binary transform_reduce requires random-access iterators");
+	static_assert(std::is_same<typename std::iterator_traits<Iter2>::iterator_category, std::random_access_iterator_tag>::value, "binary transform_reduce requires random-access iterators");
+
+	detail::partial_result<T> result = async::parallel_map_reduce_chunked(policy.scheduler(), async::make_range(first1, last1), detail::partial_result<T>(), detail::binary_transform_reduce_leaf<T, Iter1, Iter2, Reduce, Transform>{first1, first2, reduce, transform}, detail::partial_reduce<T, Reduce>{reduce});
+	return detail::finish_reduce(std::move(init), std::move(result), reduce);
+}
+template<typename Policy, typename Iter1, typename Iter2, typename T>
+typename detail::enable_if_policy<Policy, T>::type transform_reduce(const Policy& policy, Iter1 first1, Iter1 last1, Iter2 first2, T init)
+{
+	return async::transform_reduce(policy, first1, last1, first2, std::move(init), std::plus<T>(), std::multiplies<T>());
+}
+
+template<typename Policy, typename Iter, typename T, typename Reduce>
+typename detail::enable_if_policy<Policy, T>::type reduce(const Policy& policy, Iter first, Iter last, T init, const Reduce& reduce)
+{
+	return async::transform_reduce(policy, first, last, std::move(init), reduce, detail::default_map());
+}
+template<typename Policy, typename Iter, typename T>
+typename detail::enable_if_policy<Policy, T>::type reduce(const Policy& policy, Iter first, Iter last, T init)
+{
+	return async::reduce(policy, first, last, std::move(init), std::plus<T>());
+}
+template<typename Policy, typename Iter>
+typename detail::enable_if_policy<Policy, typename std::iterator_traits<Iter>::value_type>::type reduce(const Policy& policy, Iter first, Iter last)
+{
+	typedef typename std::iterator_traits<Iter>::value_type value_type;
+	return async::reduce(policy, first, last, value_type());
+}
+
+template<typename Policy, typename Iter, typename OutIter>
+typename detail::enable_if_policy<Policy, OutIter>::type copy(const Policy& policy, Iter first, Iter last, OutIter out)
+{
+	return detail::policy_copy(policy.scheduler(), first, last, out, detail::is_memory_copyable<Iter, OutIter>());
+}
+template<typename Policy, typename Iter, typename T>
+typename detail::enable_if_policy<Policy>::type fill(const Policy& policy, Iter first, Iter last, const T& value)
+{
+	detail::policy_fill(policy.scheduler(), first, last, value, detail::is_memory_copyable<Iter, Iter>());
+}
+
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, typename std::iterator_traits<Iter>::difference_type>::type count_if(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_count_if(policy.scheduler(), async::make_range(first, last), pred);
+}
+template<typename Policy, typename Iter, typename T>
+typename detail::enable_if_policy<Policy, typename std::iterator_traits<Iter>::difference_type>::type count(const Policy& policy, Iter first, Iter last, const T& value)
+{
+	return async::count_if(policy, first, last, [&value](const typename std::iterator_traits<Iter>::value_type& x) {
+		return x == value;
+	});
+}
+
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, Iter>::type find_if(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_find_if(policy.scheduler(), async::make_range(first, last), pred);
+}
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, Iter>::type find_if_not(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_find_if(policy.scheduler(), async::make_range(first, last), detail::negate_pred<Pred>{pred});
+}
+template<typename Policy, typename Iter, typename T>
+typename detail::enable_if_policy<Policy, Iter>::type find(const Policy& policy, Iter first, Iter last, const T& value)
+{
+	return async::find_if(policy, first, last, [&value](const typename std::iterator_traits<Iter>::value_type& x) {
+		return x == value;
+	});
+}
+
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, bool>::type any_of(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_any_of(policy.scheduler(), async::make_range(first, last), pred);
+}
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, bool>::type all_of(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_all_of(policy.scheduler(), async::make_range(first, last), pred);
+}
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, bool>::type none_of(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_none_of(policy.scheduler(), async::make_range(first, last), pred);
+}
+
+template<typename Policy, typename Iter, typename OutIter, typename Pred>
+typename detail::enable_if_policy<Policy, OutIter>::type copy_if(const Policy& policy, Iter first, Iter last, OutIter out, const Pred& pred)
+{
+	return async::parallel_copy_if(policy.scheduler(), async::make_range(first, last), out, pred);
+}
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, Iter>::type remove_if(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_remove_if(policy.scheduler(), async::make_range(first, last), pred);
+}
+
+// parallel_partition is stable, so it is used for both algorithms
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, Iter>::type partition(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_partition(policy.scheduler(), async::make_range(first, last), pred);
+}
+template<typename Policy, typename Iter, typename Pred>
+typename detail::enable_if_policy<Policy, Iter>::type stable_partition(const Policy& policy, Iter first, Iter last, const Pred& pred)
+{
+	return async::parallel_partition(policy.scheduler(), async::make_range(first, last), pred);
+}
+
+template<typename Policy, typename Iter, typename Compare>
+typename detail::enable_if_policy<Policy>::type sort(const Policy& policy, Iter first, Iter last, const Compare& comp)
+{
+	async::parallel_sort(policy.scheduler(), async::make_range(first, last), comp);
+}
+template<typename Policy, typename Iter>
+typename detail::enable_if_policy<Policy>::type sort(const Policy& policy, Iter first, Iter last)
+{
+	async::parallel_sort(policy.scheduler(), async::make_range(first, last));
+}
+template<typename Policy, typename Iter, typename Compare>
+typename detail::enable_if_policy<Policy>::type stable_sort(const Policy& policy, Iter first, Iter last, const Compare& comp)
+{
+	async::parallel_stable_sort(policy.scheduler(), async::make_range(first, last), comp);
+}
+template<typename Policy, typename Iter>
+typename detail::enable_if_policy<Policy>::type stable_sort(const Policy& policy, Iter first, Iter last)
+{
+	async::parallel_stable_sort(policy.scheduler(), async::make_range(first, last));
+}
+
+template<typename Policy, typename Iter1, typename Iter2, typename OutIter, typename Compare>
+typename detail::enable_if_policy<Policy, OutIter>::type merge(const Policy& policy, Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutIter out, const Compare& comp)
+{
+	return async::parallel_merge(policy.scheduler(), async::make_range(first1, last1), async::make_range(first2, last2), out, comp);
+}
+template<typename Policy, typename Iter1, typename Iter2, typename OutIter>
+typename detail::enable_if_policy<Policy, OutIter>::type merge(const Policy& policy, Iter1 first1, Iter1 last1, Iter2 first2, Iter2 last2, OutIter out)
+{
+	return async::parallel_merge(policy.scheduler(), async::make_range(first1, last1), async::make_range(first2, last2), out);
+}
+
+} // namespace async
@@ -0,0 +1,156 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Copy or fill memory using non-temporal stores where the CPU supports them.
+// stream_fill repeats a pattern of 1, 2, 4, 8 or 16 bytes, and requires the
+// destination to be aligned to the pattern size and the length to be a
+// multiple of it.
+LIBASYNC_EXPORT void stream_copy(void* dst, const void* src, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT void stream_fill(void* dst, std::size_t length, const void* pattern, std::size_t pattern_size) LIBASYNC_NOEXCEPT;
+
+// Chunks are split on page boundaries, or on huge page boundaries for very
+// large buffers, so that no two threads write to the same page.
+const std::size_t memory_page_size = 4096;
+const std::size_t memory_huge_page_size = 2 << 20;
+
+// Buffers larger than this are written with non-temporal stores since they
+// wouldn't fit in the cache anyway.
+const std::size_t memory_stream_threshold = 8 << 20;
+
+// Each thread should have at least this many bytes to work on
+const std::size_t memory_min_chunk_size = 256 << 10;
+
+// A few threads are enough to saturate memory bandwidth, using more only adds
+// contention in the memory controller and takes workers away from other work.
+const std::size_t memory_max_threads = 8;
+
+// Run a function over chunks of a contiguous array in parallel. The function
+// is called with the index and length of each chunk.
+template<typename Sched, typename T, typename Func>
+void parallel_memory_op(Sched& sched, T* data, std::size_t length, const Func& func)
+{
+	// Pick the number of chunks
+	std::size_t bytes = length * sizeof(T);
+	std::size_t num_chunks = bytes / memory_min_chunk_size;
+	std::size_t max_chunks = std::min(hardware_concurrency(), memory_max_threads);
+	if (num_chunks > max_chunks)
+		num_chunks = max_chunks;
+	if (num_chunks <= 1) {
+		func(std::size_t(0), length);
+		return;
+	}
+
+	// Find the chunk boundaries, rounded down to a page boundary in memory
+	std::size_t page = bytes >= 64 * memory_huge_page_size ? memory_huge_page_size : memory_page_size;
+	std::uintptr_t base = reinterpret_cast<std::uintptr_t>(data);
+	auto boundary = [base, bytes, num_chunks, page, length](std::size_t i) -> std::size_t {
+		if (i == num_chunks)
+			return length;
+		std::uintptr_t addr = (base + bytes / num_chunks * i) & ~static_cast<std::uintptr_t>(page - 1);
+		return addr <= base ? 0 : (addr - base) / sizeof(T);
+	};
+
+	async::parallel_for(sched, async::static_partitioner(async::irange(std::size_t(0), num_chunks), 1), [&func, &boundary](std::size_t i) {
+		std::size_t begin = boundary(i);
+		std::size_t end = boundary(i + 1);
+		if (begin != end)
+			func(begin, end - begin);
+	});
+}
+
+} // namespace detail
+
+// Copy a contiguous range of trivially copyable elements to a contiguous
+// output range in parallel. The ranges must not overlap. Large copies are
+// split on page boundaries, use non-temporal stores and only run on as many
+// threads as needed to saturate memory bandwidth. Returns an iterator to the
+// end of the output range.
+template<typename Sched, typename Range, typename OutIter>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_copy(Sched& sched, Range&& range, OutIter out)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(detail::is_contiguous_iterator<iterator>::value && detail::is_contiguous_iterator<OutIter>::value, "parallel_copy requires contiguous ranges");
+	static_assert(std::is_trivially_copyable<value_type>::value, "parallel_copy requires a trivially copyable type");
+	static_assert(std::is_same<value_type, typename std::iterator_traits<OutIter>::value_type>::value, "parallel_copy requires input and output of the same type");
+
+	iterator begin = std::begin(range);
+	std::size_t length = std::end(range) - begin;
+	if (length == 0)
+		return out;
+	const value_type* in_ptr = detail::to_pointer(begin);
+	value_type* out_ptr = detail::to_pointer(out);
+	bool stream = length * sizeof(value_type) >= detail::memory_stream_threshold;
+	detail::parallel_memory_op(sched, out_ptr, length, [in_ptr, out_ptr, stream](std::size_t offset, std::size_t chunk_length) {
+		if (stream)
+			detail::stream_copy(out_ptr + offset, in_ptr + offset, chunk_length * sizeof(value_type));
+		else
+			std::memcpy(out_ptr + offset, in_ptr + offset, chunk_length * sizeof(value_type));
+	});
+	return out + length;
+}
+
+// Fill a contiguous range of trivially copyable elements with a value in
+// parallel, using the same chunking and non-temporal stores as parallel_copy.
+template<typename Sched, typename Range, typename T>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_fill(Sched& sched, Range&& range, const T& value)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(detail::is_contiguous_iterator<iterator>::value, "parallel_fill requires a contiguous range");
+	static_assert(std::is_trivially_copyable<value_type>::value, "parallel_fill requires a trivially copyable type");
+
+	iterator begin = std::begin(range);
+	std::size_t length = std::end(range) - begin;
+	if (length == 0)
+		return;
+	value_type* ptr = detail::to_pointer(begin);
+	value_type fill_value = value;
+
+	// Streaming stores need the element size to divide their block size
+	bool stream = length * sizeof(value_type) >= detail::memory_stream_threshold && 16 % sizeof(value_type) == 0 && reinterpret_cast<std::uintptr_t>(ptr) % sizeof(value_type) == 0;
+	detail::parallel_memory_op(sched, ptr, length, [ptr, &fill_value, stream](std::size_t offset, std::size_t chunk_length) {
+		if (stream)
+			detail::stream_fill(ptr + offset, chunk_length * sizeof(value_type), &fill_value, sizeof(value_type));
+		else
+			std::fill(ptr + offset, ptr + offset + chunk_length, fill_value);
+	});
+}
+
+// Overloads with default scheduler
+template<typename Range, typename OutIter>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, OutIter>::type parallel_copy(Range&& range, OutIter out)
+{
+	return async::parallel_copy(::async::default_scheduler(), std::forward<Range>(range), out);
+}
+template<typename Range, typename T>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value>::type parallel_fill(Range&& range, const T& value)
+{
+	async::parallel_fill(::async::default_scheduler(), std::forward<Range>(range), value);
+}
+
+} // namespace async
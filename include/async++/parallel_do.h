@@ -0,0 +1,219 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+template<typename Sched, typename Iter, typename Body>
+struct parallel_do_state;
+
+} // namespace detail
+
+// Object passed to the body of parallel_do, which can be used to add new items
+// to be processed.
+template<typename T>
+class parallel_do_feeder {
+	std::vector<T> items;
+
+	template<typename Sched, typename Iter, typename Body>
+	friend struct detail::parallel_do_state;
+	parallel_do_feeder() {}
+
+public:
+	void add(const T& item)
+	{
+		items.push_back(item);
+	}
+	void add(T&& item)
+	{
+		items.push_back(std::move(item));
+	}
+};
+
+namespace detail {
+
+// Number of items taken from the input sequence at once, and number of new
+// items collected before they are made available to other threads.
+const std::size_t parallel_do_batch_size = 16;
+
+// Call the body of parallel_do, with or without a feeder
+template<typename Body, typename T>
+void parallel_do_call(const Body& body, T& item, parallel_do_feeder<T>& feeder, std::true_type)
+{
+	body(item, feeder);
+}
+template<typename Body, typename T>
+void parallel_do_call(const Body& body, T& item, parallel_do_feeder<T>&, std::false_type)
+{
+	body(item);
+}
+
+// Shared state of a parallel_do call. The input sequence is only traversed
+// once, in chunks taken under a lock by one task per thread. New items added
+// through a feeder are processed by the thread that added them, except that
+// every full batch is spawned as a separate task. Tasks spawned from a thread
+// pool worker go into its work-stealing queue, so idle threads can steal them.
+template<typename Sched, typename Iter, typename Body>
+struct parallel_do_state: public parallel_task_counter, public std::enable_shared_from_this<parallel_do_state<Sched, Iter, Body>> {
+	typedef typename std::iterator_traits<Iter>::value_type value_type;
+	typedef std::integral_constant<bool, is_callable<const Body&(value_type&, parallel_do_feeder<value_type>&)>::value> use_feeder;
+
+	Sched& sched;
+	const Body& body;
+
+	// Remaining part of the input sequence, protected by the lock
+	std::mutex lock;
+	Iter input_begin, input_end;
+
+	parallel_do_state(Sched& sched_, Iter begin_, Iter end_, const Body& body_, std::size_t num_pullers)
+		: parallel_task_counter(num_pullers), sched(sched_), body(body_), input_begin(begin_), input_end(end_) {}
+
+	// Tasks for a batch of new items and for pulling items from the input
+	struct batch_task {
+		std::shared_ptr<parallel_do_state> state;
+		std::vector<value_type> items;
+
+		void operator()()
+		{
+			LIBASYNC_TRY {
+				state->process(items);
+			} LIBASYNC_CATCH(...) {
+				state->set_exception(std::current_exception());
+			}
+			state->finish();
+		}
+	};
+	struct pull_task {
+		std::shared_ptr<parallel_do_state> state;
+
+		void operator()() const
+		{
+			LIBASYNC_TRY {
+				state->pull();
+			} LIBASYNC_CATCH(...) {
+				state->set_exception(std::current_exception());
+			}
+			state->finish();
+		}
+	};
+
+	// Spawn a task for the last batch of new items
+	void spawn_batch(std::vector<value_type>& items)
+	{
+		auto batch_begin = items.end() - parallel_do_batch_size;
+		batch_task t = {this->shared_from_this(), std::vector<value_type>(std::make_move_iterator(batch_begin), std::make_move_iterator(items.end()))};
+		items.erase(batch_begin, items.end());
+		pending.fetch_add(1, std::memory_order_relaxed);
+		LIBASYNC_TRY {
+			async::spawn(sched, std::move(t));
+		} LIBASYNC_CATCH(...) {
+			finish();
+			LIBASYNC_RETHROW();
+		}
+	}
+
+	// Process a batch of items, followed by any new items added while doing so
+	void process(std::vector<value_type>& items)
+	{
+		parallel_do_feeder<value_type> feeder;
+		while (!items.empty() && !failed.load(std::memory_order_relaxed)) {
+			for (value_type& item: items) {
+				if (failed.load(std::memory_order_relaxed))
+					return;
+				detail::parallel_do_call(body, item, feeder, use_feeder());
+				while (feeder.items.size() >= parallel_do_batch_size)
+					spawn_batch(feeder.items);
+			}
+			items.clear();
+			std::swap(items, feeder.items);
+		}
+	}
+
+	// Take chunks from the input sequence and process them until it is empty
+	void pull()
+	{
+		std::vector<value_type> items;
+		while (!failed.load(std::memory_order_relaxed)) {
+			{
+				std::lock_guard<std::mutex> locked(lock);
+				for (std::size_t i = 0; i < parallel_do_batch_size && input_begin != input_end; i++, ++input_begin)
+					items.push_back(*input_begin);
+			}
+			if (items.empty())
+				return;
+			process(items);
+		}
+	}
+};
+
+} // namespace detail
+
+// Run a function for each item of a sequence, and for each item added by the
+// function using the parallel_do_feeder passed as its second parameter. The
+// function can also take just the item if it doesn't add new items. This is
+// useful when the amount of work isn't known in advance, for example when
+// traversing a graph. The input sequence only needs input iterators, since it
+// is traversed once, a chunk at a time, under a lock.
+template<typename Sched, typename Range, typename Body>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_do(Sched& sched, Range&& range, const Body& body)
+{
+	typedef detail::parallel_do_state<Sched, decltype(std::begin(range)), Body> state_type;
+
+	// Start one task per thread pulling from the input sequence, one of which
+	// runs in the current thread.
+	std::size_t num_pullers = hardware_concurrency();
+	std::shared_ptr<state_type> state = std::make_shared<state_type>(sched, std::begin(range), std::end(range), body, num_pullers);
+	task<void> t = state->event.get_task();
+	for (std::size_t i = 1; i < num_pullers; i++) {
+		LIBASYNC_TRY {
+			async::spawn(sched, typename state_type::pull_task{state});
+		} LIBASYNC_CATCH(...) {
+			state->set_exception(std::current_exception());
+			state->finish();
+		}
+	}
+	typename state_type::pull_task{state}();
+	t.get();
+}
+
+// Overloads with default scheduler
+template<typename Range, typename Body>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value>::type parallel_do(Range&& range, const Body& body)
+{
+	async::parallel_do(::async::default_scheduler(), std::forward<Range>(range), body);
+}
+
+// Overloads with std::initializer_list
+template<typename Sched, typename T, typename Body>
+void parallel_do(Sched& sched, std::initializer_list<T> range, const Body& body)
+{
+	async::parallel_do(sched, async::make_range(range.begin(), range.end()), body);
+}
+template<typename T, typename Body>
+void parallel_do(std::initializer_list<T> range, const Body& body)
+{
+	async::parallel_do(async::make_range(range.begin(), range.end()), body);
+}
+
+} // namespace async
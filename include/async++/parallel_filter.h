@@ -0,0 +1,237 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Size of the chunks used by the stream compaction algorithms. Each chunk needs
+// a count and an offset, so chunks shouldn't be too small.
+inline std::size_t filter_grain_size(std::size_t dist)
+{
+	std::size_t grain = detail::auto_grain_size(dist);
+	if (grain < 1024)
+		grain = 1024;
+	return grain;
+}
+
+// Replace each count with the sum of the counts before it, and return the
+// total. The number of chunks is small so this is done sequentially.
+inline std::size_t exclusive_scan_counts(std::vector<std::size_t>& counts)
+{
+	std::size_t total = 0;
+	for (std::size_t& i: counts) {
+		std::size_t count = i;
+		i = total;
+		total += count;
+	}
+	return total;
+}
+
+// First pass of the stream compaction algorithms: count the elements matching
+// the predicate in each chunk. On return, offsets contains the position of the
+// first matching element of each chunk in the output, and the total number of
+// matching elements is returned. The counting loop has no stores, which makes
+// it cheaper to evaluate the predicate again in the second pass than to store
+// its result for each element.
+template<typename Sched, typename Iter, typename Pred>
+std::size_t filter_count(Sched& sched, Iter begin, std::size_t length, std::size_t grain, const Pred& pred, std::vector<std::size_t>& offsets)
+{
+	std::size_t num_chunks = (length + grain - 1) / grain;
+	offsets.resize(num_chunks);
+	async::parallel_for(sched, async::irange(std::size_t(0), num_chunks), [begin, length, grain, &pred, &offsets](std::size_t chunk) {
+		std::size_t first = chunk * grain;
+		std::size_t last = std::min(first + grain, length);
+		std::size_t count = 0;
+		for (std::size_t i = first; i < last; i++)
+			count += pred(begin[i]) ? 1 : 0;
+		offsets[chunk] = count;
+	});
+	return detail::exclusive_scan_counts(offsets);
+}
+
+} // namespace detail
+
+// Copy the elements of a random-access range which match a predicate to an
+// output range, preserving their relative order. The predicate is called twice
+// for each element. Returns the end of the output range.
+template<typename Sched, typename Range, typename OutIter, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_copy_if(Sched& sched, Range&& range, OutIter out, const Pred& pred)
+{
+	typedef decltype(std::begin(range)) iterator;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_copy_if requires a random-access range");
+	static_assert(std::is_same<typename std::iterator_traits<OutIter>::iterator_category, std::random_access_iterator_tag>::value, "parallel_copy_if requires a random-access output iterator");
+
+	iterator begin = std::begin(range);
+	std::size_t length = std::end(range) - begin;
+	std::size_t grain = detail::filter_grain_size(length);
+	std::vector<std::size_t> offsets;
+	std::size_t total = detail::filter_count(sched, begin, length, grain, pred, offsets);
+
+	// Copy the matching elements of each chunk to their final position
+	async::parallel_for(sched, async::irange(std::size_t(0), offsets.size()), [begin, out, length, grain, &pred, &offsets](std::size_t chunk) {
+		std::size_t first = chunk * grain;
+		std::size_t last = std::min(first + grain, length);
+		OutIter chunk_out = out + offsets[chunk];
+		for (std::size_t i = first; i < last; i++) {
+			if (pred(begin[i])) {
+				*chunk_out = begin[i];
+				++chunk_out;
+			}
+		}
+	});
+	return out + total;
+}
+
+// Remove the elements of a random-access range which match a predicate,
+// preserving the relative order of the remaining elements. Returns the new end
+// of the range; elements after it are left in a valid but unspecified state,
+// like std::remove_if. Each chunk is first compacted in place in parallel.
+//
+// The chunks then need to be moved together. A chunk can't simply be moved to
+// its final position in parallel with the others, because its destination may
+// overlap the remaining elements of earlier chunks. Instead the elements which
+// need to move are moved into a scratch buffer and back in two parallel passes.
+// If moving the element type can throw then this second step is done
+// sequentially, in place.
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_remove_if(Sched& sched, Range&& range, const Pred& pred)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_remove_if requires a random-access range");
+
+	iterator begin = std::begin(range);
+	std::size_t length = std::end(range) - begin;
+	std::size_t grain = detail::filter_grain_size(length);
+	std::size_t num_chunks = (length + grain - 1) / grain;
+	std::vector<std::size_t> offsets(num_chunks);
+	async::parallel_for(sched, async::irange(std::size_t(0), num_chunks), [begin, length, grain, &pred, &offsets](std::size_t chunk) {
+		iterator first = begin + chunk * grain;
+		iterator last = begin + std::min(chunk * grain + grain, length);
+		offsets[chunk] = std::remove_if(first, last, pred) - first;
+	});
+	std::vector<std::size_t> counts = offsets;
+	std::size_t total = detail::exclusive_scan_counts(offsets);
+
+	// Chunks before the first removed element are already in place. After it,
+	// every chunk has to move.
+	std::size_t first_moved = 0;
+	while (first_moved < num_chunks && offsets[first_moved] == first_moved * grain)
+		first_moved++;
+	if (first_moved == num_chunks)
+		return begin + total;
+
+	if (!std::is_nothrow_move_constructible<value_type>::value || !std::is_nothrow_move_assignable<value_type>::value) {
+		// Elements only move towards the start of the range, so the chunks can
+		// safely be moved in order.
+		for (std::size_t chunk = first_moved; chunk < num_chunks; chunk++) {
+			iterator first = begin + chunk * grain;
+			std::move(first, first + counts[chunk], begin + offsets[chunk]);
+		}
+		return begin + total;
+	}
+
+	// Move the elements out of their chunks, and then into their final
+	// position once no chunk still needs its source elements.
+	std::size_t buffer_base = offsets[first_moved];
+	std::allocator<value_type> alloc;
+	value_type* buffer = alloc.allocate(total - buffer_base);
+	async::parallel_for(sched, async::irange(first_moved, num_chunks), [begin, grain, buffer, buffer_base, &offsets, &counts](std::size_t chunk) {
+		iterator first = begin + chunk * grain;
+		value_type* out = buffer + (offsets[chunk] - buffer_base);
+		for (std::size_t i = 0; i < counts[chunk]; i++)
+			new(out + i) value_type(std::move(first[i]));
+	});
+	async::parallel_for(sched, async::irange(first_moved, num_chunks), [begin, buffer, buffer_base, &offsets, &counts](std::size_t chunk) {
+		value_type* in = buffer + (offsets[chunk] - buffer_base);
+		iterator out = begin + offsets[chunk];
+		for (std::size_t i = 0; i < counts[chunk]; i++) {
+			out[i] = std::move(in[i]);
+			in[i].~value_type();
+		}
+	});
+	alloc.deallocate(buffer, total - buffer_base);
+	return begin + total;
+}
+
+// Reorder the elements of a random-access range so that the elements which
+// match a predicate come before the ones that don't, preserving the relative
+// order within each group. The predicate is called twice for each element.
+// Returns an iterator to the first element of the second group. This uses a scratch
+// buffer of the same size as the range.
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_partition(Sched& sched, Range&& range, const Pred& pred)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_partition requires a random-access range");
+
+	iterator begin = std::begin(range);
+	std::size_t length = std::end(range) - begin;
+	std::size_t grain = detail::filter_grain_size(length);
+	std::vector<std::size_t> offsets;
+	std::size_t total = detail::filter_count(sched, begin, length, grain, pred, offsets);
+	if (total == 0 || total == length)
+		return begin + total;
+
+	// Move the elements into the scratch buffer and scatter them back into the
+	// original range. Non-matching elements go after all the matching ones, and
+	// their position is the number of non-matching elements before them.
+	std::vector<value_type> buffer(std::make_move_iterator(begin), std::make_move_iterator(begin + length));
+	async::parallel_for(sched, async::irange(std::size_t(0), offsets.size()), [begin, length, grain, total, &pred, &buffer, &offsets](std::size_t chunk) {
+		std::size_t first = chunk * grain;
+		std::size_t last = std::min(first + grain, length);
+		iterator true_out = begin + offsets[chunk];
+		iterator false_out = begin + total + (first - offsets[chunk]);
+		for (std::size_t i = first; i < last; i++) {
+			if (pred(buffer[i])) {
+				*true_out = std::move(buffer[i]);
+				++true_out;
+			} else {
+				*false_out = std::move(buffer[i]);
+				++false_out;
+			}
+		}
+	});
+	return begin + total;
+}
+
+// Overloads with default scheduler
+template<typename Range, typename OutIter, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, OutIter>::type parallel_copy_if(Range&& range, OutIter out, const Pred& pred)
+{
+	return async::parallel_copy_if(::async::default_scheduler(), std::forward<Range>(range), out, pred);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_remove_if(Range&& range, const Pred& pred)
+{
+	return async::parallel_remove_if(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_partition(Range&& range, const Pred& pred)
+{
+	return async::parallel_partition(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+
+} // namespace async
@@ -0,0 +1,243 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Number of elements searched between checks for a better match found by
+// another thread.
+const std::size_t find_check_interval = 64;
+
+// Search a partition for the first element matching a predicate, stopping at
+// elements past the best match found so far. If a match is found, best is
+// lowered to its index relative to base.
+template<typename Iter, typename Pred>
+bool find_if_chunk(Iter begin, Iter end, Iter base, const Pred& pred, std::atomic<std::size_t>& best)
+{
+	std::size_t index = begin - base;
+	for (; begin != end; ++begin, ++index) {
+		if (index % find_check_interval == 0 && index >= best.load(std::memory_order_relaxed))
+			return false;
+		if (pred(*begin)) {
+			std::size_t current = best.load(std::memory_order_relaxed);
+			while (index < current && !best.compare_exchange_weak(current, index, std::memory_order_relaxed)) {}
+			return true;
+		}
+	}
+	return false;
+}
+
+// Internal implementation of parallel_find_if. Partitions which start after the
+// best match found so far are skipped without being split any further.
+template<typename Sched, typename Partitioner, typename Iter, typename Pred>
+void internal_parallel_find_if(Sched& sched, Partitioner partitioner, Iter base, const Pred& pred, std::atomic<std::size_t>& best)
+{
+	if (static_cast<std::size_t>(partitioner.begin() - base) >= best.load(std::memory_order_relaxed))
+		return;
+
+	// Split the partition, processing deferred partitions inline (see
+	// internal_parallel_for). A match in the current partition means that the
+	// deferred part can be skipped since it comes later in the range.
+	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		if (detail::find_if_chunk(partitioner.begin(), partitioner.end(), base, pred, best))
+			return;
+		partitioner = std::move(subpart);
+		if (static_cast<std::size_t>(partitioner.begin() - base) >= best.load(std::memory_order_relaxed))
+			return;
+		subpart = partitioner.split();
+	}
+
+	// Search inline if no more splits are possible
+	if (subpart.begin() == subpart.end()) {
+		detail::find_if_chunk(partitioner.begin(), partitioner.end(), base, pred, best);
+		return;
+	}
+
+	// Search each half in parallel
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, base, &pred, &best] {
+		detail::internal_parallel_find_if(sched, std::move(subpart), base, pred, best);
+	});
+	detail::internal_parallel_find_if(sched, std::move(partitioner), base, pred, best);
+	t.get();
+}
+
+// Check whether any element of a partition matches a predicate, stopping early
+// if another thread has found a match.
+template<typename Iter, typename Pred>
+void any_of_chunk(Iter begin, Iter end, const Pred& pred, std::atomic<bool>& found)
+{
+	std::size_t count = 0;
+	for (; begin != end; ++begin, ++count) {
+		if (count % find_check_interval == 0 && found.load(std::memory_order_relaxed))
+			return;
+		if (pred(*begin)) {
+			found.store(true, std::memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+// Internal implementation of parallel_any_of. This is similar to
+// internal_parallel_find_if, except that any match stops the whole search so
+// element positions aren't needed.
+template<typename Sched, typename Partitioner, typename Pred>
+void internal_parallel_any_of(Sched& sched, Partitioner partitioner, const Pred& pred, std::atomic<bool>& found)
+{
+	if (found.load(std::memory_order_relaxed))
+		return;
+
+	// Split the partition, processing deferred partitions inline
+	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		detail::any_of_chunk(partitioner.begin(), partitioner.end(), pred, found);
+		if (found.load(std::memory_order_relaxed))
+			return;
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Search inline if no more splits are possible
+	if (subpart.begin() == subpart.end()) {
+		detail::any_of_chunk(partitioner.begin(), partitioner.end(), pred, found);
+		return;
+	}
+
+	// Search each half in parallel
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &pred, &found] {
+		detail::internal_parallel_any_of(sched, std::move(subpart), pred, found);
+	});
+	detail::internal_parallel_any_of(sched, std::move(partitioner), pred, found);
+	t.get();
+}
+
+// Negate a predicate
+template<typename Pred>
+struct negate_pred {
+	const Pred& pred;
+
+	template<typename T>
+	bool operator()(T&& x) const
+	{
+		return !pred(std::forward<T>(x));
+	}
+};
+
+} // namespace detail
+
+// Find the first element of a random-access range which matches a predicate.
+// Returns the end of the range if there is no match. Parts of the range after
+// a match are skipped, so this is much faster than a full scan when a match is
+// found early.
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_find_if(Sched& sched, Range&& range, const Pred& pred)
+{
+	typedef decltype(std::begin(range)) iterator;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_find_if requires a random-access range");
+
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	iterator begin = partitioner.begin();
+	std::size_t length = partitioner.end() - begin;
+	std::atomic<std::size_t> best(length);
+	detail::internal_parallel_find_if(sched, std::move(partitioner), begin, pred, best);
+	return begin + best.load(std::memory_order_relaxed);
+}
+
+// Check whether any, all or none of the elements of a range match a predicate.
+// The search stops as soon as the result is known.
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, bool>::type parallel_any_of(Sched& sched, Range&& range, const Pred& pred)
+{
+	std::atomic<bool> found(false);
+	detail::internal_parallel_any_of(sched, async::to_partitioner(std::forward<Range>(range)), pred, found);
+	return found.load(std::memory_order_relaxed);
+}
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, bool>::type parallel_all_of(Sched& sched, Range&& range, const Pred& pred)
+{
+	return !async::parallel_any_of(sched, std::forward<Range>(range), detail::negate_pred<Pred>{pred});
+}
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, bool>::type parallel_none_of(Sched& sched, Range&& range, const Pred& pred)
+{
+	return !async::parallel_any_of(sched, std::forward<Range>(range), pred);
+}
+
+// Overloads with default scheduler
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, decltype(std::begin(std::declval<Range>()))>::type parallel_find_if(Range&& range, const Pred& pred)
+{
+	return async::parallel_find_if(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, bool>::type parallel_any_of(Range&& range, const Pred& pred)
+{
+	return async::parallel_any_of(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, bool>::type parallel_all_of(Range&& range, const Pred& pred)
+{
+	return async::parallel_all_of(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, bool>::type parallel_none_of(Range&& range, const Pred& pred)
+{
+	return async::parallel_none_of(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+
+// Overloads with std::initializer_list
+template<typename Sched, typename T, typename Pred>
+bool parallel_any_of(Sched& sched, std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_any_of(sched, async::make_range(range.begin(), range.end()), pred);
+}
+template<typename T, typename Pred>
+bool parallel_any_of(std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_any_of(async::make_range(range.begin(), range.end()), pred);
+}
+template<typename Sched, typename T, typename Pred>
+bool parallel_all_of(Sched& sched, std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_all_of(sched, async::make_range(range.begin(), range.end()), pred);
+}
+template<typename T, typename Pred>
+bool parallel_all_of(std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_all_of(async::make_range(range.begin(), range.end()), pred);
+}
+template<typename Sched, typename T, typename Pred>
+bool parallel_none_of(Sched& sched, std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_none_of(sched, async::make_range(range.begin(), range.end()), pred);
+}
+template<typename T, typename Pred>
+bool parallel_none_of(std::initializer_list<T> range, const Pred& pred)
+{
+	return async::parallel_none_of(async::make_range(range.begin(), range.end()), pred);
+}
+
+} // namespace async
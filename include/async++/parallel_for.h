@@ -30,8 +30,18 @@ namespace detail {
 template<typename Sched, typename Partitioner, typename Func>
 void internal_parallel_for(Sched& sched, Partitioner partitioner, const Func& func)
 {
-	// Split the partition, run inline if no more splits are possible
+	// Split the partition. If the partitioner defers the rest of the range
+	// then we process the current partition inline and continue with the rest
+	// of the range in this thread, without spawning a task for it.
 	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		for (auto&& i: partitioner)
+			func(std::forward<decltype(i)>(i));
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Run inline if no more splits are possible
 	if (subpart.begin() == subpart.end()) {
 		for (auto&& i: partitioner)
 			func(std::forward<decltype(i)>(i));
@@ -39,13 +49,141 @@ void internal_parallel_for(Sched& sched, Partitioner partitioner, const Func& fu
 	}
 
 	// Run the function over each half in parallel
-	auto&& t = async::local_spawn(sched, [&sched, &subpart, &func] {
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &func] {
 		detail::internal_parallel_for(sched, std::move(subpart), func);
 	});
 	detail::internal_parallel_for(sched, std::move(partitioner), func);
 	t.get();
 }
 
+// Completion tracking for parallel algorithms which spawn tasks without
+// waiting for them. Instead of waiting for the tasks it spawns, each task
+// counts them in pending, and the last task to finish completes the event. This
+// way no thread is ever blocked waiting for another.
+struct parallel_task_counter {
+	event_task<void> event;
+	std::atomic<std::size_t> pending;
+	std::atomic<bool> failed;
+	std::exception_ptr except;
+
+	explicit parallel_task_counter(std::size_t pending_)
+		: pending(pending_), failed(false) {}
+
+	// Only the first exception is kept, and once a task has failed the
+	// remaining partitions are skipped.
+	void set_exception(std::exception_ptr except_)
+	{
+		if (!failed.exchange(true, std::memory_order_relaxed))
+			except = std::move(except_);
+	}
+
+	// Called when a task has finished processing its partitions
+	void finish()
+	{
+		if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		if (failed.load(std::memory_order_relaxed))
+			event.set_exception(std::move(except));
+		else
+			event.set();
+	}
+};
+
+// Shared state of a parallel_for_async call. Each task which processes part of
+// the range holds a reference to it.
+template<typename Sched, typename Func>
+struct parallel_for_async_state: public parallel_task_counter {
+	Sched& sched;
+	Func func;
+
+	parallel_for_async_state(Sched& sched_, Func func_)
+		: parallel_task_counter(1), sched(sched_), func(std::move(func_)) {}
+};
+
+// Process a partition for parallel_for_async. Split off parts are spawned as
+// separate tasks while this task continues with the first part.
+template<typename State, typename Partitioner>
+void parallel_for_async_run(const std::shared_ptr<State>& state, Partitioner partitioner)
+{
+	LIBASYNC_TRY {
+		auto subpart = partitioner.split();
+		while (!state->failed.load(std::memory_order_relaxed)) {
+			// Process deferred and unsplittable partitions inline
+			if (detail::partition_deferred(subpart, 0) || subpart.begin() == subpart.end()) {
+				for (auto&& i: partitioner)
+					state->func(std::forward<decltype(i)>(i));
+				if (subpart.begin() == subpart.end())
+					break;
+				partitioner = std::move(subpart);
+				subpart = partitioner.split();
+				continue;
+			}
+
+			// Spawn a task for the second half
+			state->pending.fetch_add(1, std::memory_order_relaxed);
+			LIBASYNC_TRY {
+				auto&& subpart_sched = detail::partition_scheduler(state->sched, subpart);
+				async::spawn(subpart_sched, [state, subpart] {
+					detail::parallel_for_async_run(state, subpart);
+				});
+			} LIBASYNC_CATCH(...) {
+				state->set_exception(std::current_exception());
+				state->finish();
+			}
+			subpart = partitioner.split();
+		}
+	} LIBASYNC_CATCH(...) {
+		state->set_exception(std::current_exception());
+	}
+	state->finish();
+}
+
+// Internal implementation of parallel_for_chunked that only accepts a
+// partitioner argument.
+template<typename Sched, typename Partitioner, typename Func>
+void internal_parallel_for_chunked(Sched& sched, Partitioner partitioner, const Func& func)
+{
+	// Split the partition, processing deferred partitions inline (see
+	// internal_parallel_for).
+	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		if (!detail::partition_empty(partitioner))
+			func(detail::partition_chunk(partitioner));
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Pass the whole chunk to the function if no more splits are possible.
+	// Empty chunks are skipped.
+	if (detail::partition_empty(subpart)) {
+		if (!detail::partition_empty(partitioner))
+			func(detail::partition_chunk(partitioner));
+		return;
+	}
+
+	// Run the function over each half in parallel
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &func] {
+		detail::internal_parallel_for_chunked(sched, std::move(subpart), func);
+	});
+	detail::internal_parallel_for_chunked(sched, std::move(partitioner), func);
+	t.get();
+}
+
+// Blocked ranges have no elements to iterate over, so parallel_for passes each
+// block to the function, like parallel_for_chunked.
+template<typename Sched, typename RowValue, typename ColValue, typename Func>
+void internal_parallel_for(Sched& sched, blocked_range2d<RowValue, ColValue> partitioner, const Func& func)
+{
+	detail::internal_parallel_for_chunked(sched, std::move(partitioner), func);
+}
+template<typename Sched, typename PageValue, typename RowValue, typename ColValue, typename Func>
+void internal_parallel_for(Sched& sched, blocked_range3d<PageValue, RowValue, ColValue> partitioner, const Func& func)
+{
+	detail::internal_parallel_for_chunked(sched, std::move(partitioner), func);
+}
+
 } // namespace detail
 
 // Run a function for each element in a range
@@ -74,4 +212,60 @@ void parallel_for(std::initializer_list<T> range, const Func& func)
 	async::parallel_for(async::make_range(range.begin(), range.end()), func);
 }
 
+// Asynchronous version of parallel_for which returns immediately. The returned
+// task completes once the function has been run for every element, or with
+// the first exception thrown by the function, in which case some elements may
+// not be processed. The function is copied, and the range must remain valid
+// until the task completes. No thread is blocked waiting for the work, so the
+// result can be chained with then() or combined with when_all().
+template<typename Sched, typename Range, typename Func>
+task<void> parallel_for_async(Sched& sched, Range&& range, Func&& func)
+{
+	typedef detail::parallel_for_async_state<Sched, typename std::decay<Func>::type> state_type;
+	std::shared_ptr<state_type> state = std::make_shared<state_type>(sched, std::forward<Func>(func));
+	task<void> out = state->event.get_task();
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	async::spawn(sched, [state, partitioner] {
+		detail::parallel_for_async_run(state, partitioner);
+	});
+	return out;
+}
+
+// Overload with default scheduler
+template<typename Range, typename Func>
+task<void> parallel_for_async(Range&& range, Func&& func)
+{
+	return async::parallel_for_async(::async::default_scheduler(), std::forward<Range>(range), std::forward<Func>(func));
+}
+
+// Run a function for each chunk of a range. Instead of being called once per
+// element, the function is called with an async::range covering all the
+// elements of a chunk, which allows it to use vectorized loops and local
+// accumulators. Multi-dimensional ranges such as blocked_range2d pass each
+// block to the function directly.
+template<typename Sched, typename Range, typename Func>
+void parallel_for_chunked(Sched& sched, Range&& range, const Func& func)
+{
+	detail::internal_parallel_for_chunked(sched, async::to_partitioner(std::forward<Range>(range)), func);
+}
+
+// Overload with default scheduler
+template<typename Range, typename Func>
+void parallel_for_chunked(Range&& range, const Func& func)
+{
+	async::parallel_for_chunked(::async::default_scheduler(), range, func);
+}
+
+// Overloads with std::initializer_list
+template<typename Sched, typename T, typename Func>
+void parallel_for_chunked(Sched& sched, std::initializer_list<T> range, const Func& func)
+{
+	async::parallel_for_chunked(sched, async::make_range(range.begin(), range.end()), func);
+}
+template<typename T, typename Func>
+void parallel_for_chunked(std::initializer_list<T> range, const Func& func)
+{
+	async::parallel_for_chunked(async::make_range(range.begin(), range.end()), func);
+}
+
 } // namespace async
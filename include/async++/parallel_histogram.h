@@ -0,0 +1,288 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Number of shards used by parallel_group_reduce, as a power of 2. We use
+// several shards per thread so that the merge can be load balanced.
+inline unsigned group_shard_bits()
+{
+	unsigned bits = 2;
+	while ((std::size_t(1) << bits) < 4 * hardware_concurrency() && bits < 12)
+		bits++;
+	return bits;
+}
+
+// Select the shard for a hash value. The hash is mixed first so that the shard
+// doesn't depend only on the low bits, which the hash tables within each shard
+// also use to pick a bucket.
+inline std::size_t group_shard(std::size_t hash, unsigned bits)
+{
+	std::uint32_t mixed = static_cast<std::uint32_t>(hash ^ (hash >> 16)) * 0x9e3779b9u;
+	return mixed >> (32 - bits);
+}
+
+// Insert a value into a hash table, combining it with the existing value if
+// the key is already present.
+template<typename Map, typename Key, typename Value, typename Op>
+void group_insert(Map& map, Key&& key, Value&& value, const Op& op)
+{
+	auto it = map.find(key);
+	if (it == map.end())
+		map.emplace(std::forward<Key>(key), std::forward<Value>(value));
+	else
+		it->second = op(std::move(it->second), std::forward<Value>(value));
+}
+
+// Bin count above which parallel_histogram uses the sharded hash tables of
+// parallel_group_reduce instead of a dense table per thread. A dense table of
+// this size takes 512KB, and zeroing and summing one per thread would cost
+// more than the counting itself for larger or sparsely used tables.
+const std::size_t histogram_dense_limit = 65536;
+
+// Dense table of bin counts for one thread. The table is aligned and padded to
+// whole cache lines so that threads never write to the same line.
+typedef aligned_array<std::size_t, LIBASYNC_CACHELINE_SIZE> histogram_table;
+inline histogram_table make_histogram_table(std::size_t num_bins)
+{
+	const std::size_t line = LIBASYNC_CACHELINE_SIZE / sizeof(std::size_t);
+	histogram_table table((num_bins + line - 1) / line * line);
+	std::fill(table.get(), table.get() + table.size(), std::size_t(0));
+	return table;
+}
+
+// Leaf functions for parallel_histogram and parallel_group_reduce, which are
+// called with a chunk of the input range.
+template<typename KeyFn>
+struct histogram_leaf {
+	combinable<histogram_table>& tables;
+	std::size_t num_bins;
+	const KeyFn& key_fn;
+
+	template<typename Chunk>
+	void operator()(const Chunk& chunk) const
+	{
+		histogram_table& table = tables.local();
+		for (auto&& x: chunk) {
+			std::size_t bin = key_fn(x);
+			LIBASYNC_ASSERT(bin < num_bins, std::out_of_range, "parallel_histogram bin index out of range");
+			table[bin]++;
+		}
+	}
+};
+template<typename Map, typename KeyFn, typename ValueFn, typename Op>
+struct group_reduce_leaf {
+	combinable<std::vector<Map>>& tables;
+	unsigned shard_bits;
+	const KeyFn& key_fn;
+	const ValueFn& value_fn;
+	const Op& op;
+
+	template<typename Chunk>
+	void operator()(const Chunk& chunk) const
+	{
+		std::vector<Map>& shards = tables.local();
+		typename Map::hasher hash;
+		for (auto&& x: chunk) {
+			typename Map::key_type key = key_fn(x);
+			Map& shard = shards[detail::group_shard(hash(key), shard_bits)];
+			detail::group_insert(shard, std::move(key), value_fn(x), op);
+		}
+	}
+};
+
+// Key and value functions used by parallel_histogram for large bin counts
+template<typename KeyFn>
+struct histogram_key {
+	std::size_t num_bins;
+	const KeyFn& key_fn;
+
+	template<typename T>
+	std::size_t operator()(T&& x) const
+	{
+		std::size_t bin = key_fn(std::forward<T>(x));
+		LIBASYNC_ASSERT(bin < num_bins, std::out_of_range, "parallel_histogram bin index out of range");
+		return bin;
+	}
+};
+struct histogram_count {
+	template<typename T>
+	std::size_t operator()(T&&) const
+	{
+		return 1;
+	}
+};
+
+// Hash table type returned by parallel_group_reduce
+template<typename Range, typename KeyFn, typename ValueFn>
+struct group_reduce_map {
+	typedef std::unordered_map<typename std::decay<decltype(std::declval<KeyFn>()(*std::begin(std::declval<Range>())))>::type, typename std::decay<decltype(std::declval<ValueFn>()(*std::begin(std::declval<Range>())))>::type> type;
+};
+
+// Aggregate a range into per-thread sharded hash tables and merge each shard
+// in parallel. Shards contain disjoint sets of keys.
+template<typename Sched, typename Range, typename KeyFn, typename ValueFn, typename Op>
+std::vector<typename group_reduce_map<Range, KeyFn, ValueFn>::type> internal_parallel_group_reduce(Sched& sched, Range&& range, const KeyFn& key_fn, const ValueFn& value_fn, const Op& op)
+{
+	typedef typename group_reduce_map<Range, KeyFn, ValueFn>::type map_type;
+
+	unsigned shard_bits = detail::group_shard_bits();
+	std::size_t num_shards = std::size_t(1) << shard_bits;
+	combinable<std::vector<map_type>> tables([num_shards] {
+		return std::vector<map_type>(num_shards);
+	});
+	async::parallel_for_chunked(sched, std::forward<Range>(range), detail::group_reduce_leaf<map_type, KeyFn, ValueFn, Op>{tables, shard_bits, key_fn, value_fn, op});
+
+	// Merge the per-thread tables one shard at a time
+	std::vector<std::vector<map_type>*> table_list;
+	tables.combine_each([&table_list](std::vector<map_type>& table) {
+		table_list.push_back(&table);
+	});
+	std::vector<map_type> merged(num_shards);
+	async::parallel_for(sched, async::irange(std::size_t(0), num_shards), [&table_list, &merged, &op](std::size_t shard) {
+		map_type& out = merged[shard];
+		for (std::vector<map_type>* table: table_list) {
+			map_type& in = (*table)[shard];
+			if (out.empty()) {
+				out = std::move(in);
+				continue;
+			}
+			for (auto& i: in)
+				detail::group_insert(out, i.first, std::move(i.second), op);
+		}
+	});
+	return merged;
+}
+
+} // namespace detail
+
+// Count the elements of a range falling in each of num_bins bins, where
+// key_fn maps an element to its bin index. Returns a vector of num_bins
+// counts.
+//
+// For up to histogram_dense_limit bins, each worker thread counts into a
+// private cache-aligned dense table, so there is no contention between
+// threads, and the tables are summed in parallel at the end. Larger bin counts
+// are aggregated like parallel_group_reduce, into hash tables sharded by bin,
+// which are then written to the output in parallel.
+template<typename Sched, typename Range, typename KeyFn>
+typename std::enable_if<detail::is_scheduler<Sched>::value, std::vector<std::size_t>>::type parallel_histogram(Sched& sched, Range&& range, std::size_t num_bins, const KeyFn& key_fn)
+{
+	std::vector<std::size_t> out(num_bins);
+	if (num_bins > detail::histogram_dense_limit) {
+		auto shards = detail::internal_parallel_group_reduce(sched, std::forward<Range>(range), detail::histogram_key<KeyFn>{num_bins, key_fn}, detail::histogram_count(), std::plus<std::size_t>());
+		async::parallel_for(sched, shards, [&out](const typename decltype(shards)::value_type& shard) {
+			for (auto& i: shard)
+				out[i.first] = i.second;
+		});
+		return out;
+	}
+
+	combinable<detail::histogram_table> tables([num_bins] {
+		return detail::make_histogram_table(num_bins);
+	});
+	async::parallel_for_chunked(sched, std::forward<Range>(range), detail::histogram_leaf<KeyFn>{tables, num_bins, key_fn});
+
+	// Sum the per-thread tables, splitting the bins between threads
+	std::vector<const std::size_t*> table_list;
+	tables.combine_each([&table_list](const detail::histogram_table& table) {
+		table_list.push_back(table.get());
+	});
+	async::parallel_for_chunked(sched, async::irange(std::size_t(0), num_bins), [&table_list, &out](async::range<int_range<std::size_t>::iterator> bins) {
+		std::size_t bins_begin = *bins.begin();
+		std::size_t bins_end = bins_begin + (bins.end() - bins.begin());
+		for (const std::size_t* data: table_list) {
+			for (std::size_t i = bins_begin; i < bins_end; i++)
+				out[i] += data[i];
+		}
+	});
+	return out;
+}
+
+// Group the elements of a range by the key returned by key_fn, and combine the
+// results of value_fn for all elements with the same key using op, which must
+// be associative and commutative since values are combined in an unspecified
+// order. Returns the result as a vector of hash tables with disjoint sets of
+// keys, so that no step of the aggregation is sequential.
+//
+// Each worker thread aggregates into private hash tables, which are split into
+// shards by key hash. The final merge then processes shards in parallel: each
+// shard only contains its own keys, so no hash table is ever copied whole.
+template<typename Sched, typename Range, typename KeyFn, typename ValueFn, typename Op>
+typename std::enable_if<detail::is_scheduler<Sched>::value, std::vector<typename detail::group_reduce_map<Range, KeyFn, ValueFn>::type>>::type
+parallel_group_reduce_sharded(Sched& sched, Range&& range, const KeyFn& key_fn, const ValueFn& value_fn, const Op& op)
+{
+	return detail::internal_parallel_group_reduce(sched, std::forward<Range>(range), key_fn, value_fn, op);
+}
+
+// Same as parallel_group_reduce_sharded, but returns a single hash table. The
+// shards are gathered into it sequentially, which takes time proportional to
+// the number of distinct keys. With C++17 the hash table nodes are moved
+// without copying keys or values, otherwise keys are copied.
+template<typename Sched, typename Range, typename KeyFn, typename ValueFn, typename Op>
+typename std::enable_if<detail::is_scheduler<Sched>::value, typename detail::group_reduce_map<Range, KeyFn, ValueFn>::type>::type
+parallel_group_reduce(Sched& sched, Range&& range, const KeyFn& key_fn, const ValueFn& value_fn, const Op& op)
+{
+	typedef typename detail::group_reduce_map<Range, KeyFn, ValueFn>::type map_type;
+	std::vector<map_type> shards = detail::internal_parallel_group_reduce(sched, std::forward<Range>(range), key_fn, value_fn, op);
+
+	// Keys are distinct across shards so this is only a sequence of insertions
+	std::size_t total = 0;
+	for (map_type& shard: shards)
+		total += shard.size();
+	map_type out;
+	out.reserve(total);
+	for (map_type& shard: shards) {
+#if __cplusplus >= 201703L
+		while (!shard.empty())
+			out.insert(shard.extract(shard.begin()));
+#else
+		for (auto& i: shard)
+			out.emplace(i.first, std::move(i.second));
+#endif
+	}
+	return out;
+}
+
+// Overloads with default scheduler
+template<typename Range, typename KeyFn>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, std::vector<std::size_t>>::type parallel_histogram(Range&& range, std::size_t num_bins, const KeyFn& key_fn)
+{
+	return async::parallel_histogram(::async::default_scheduler(), std::forward<Range>(range), num_bins, key_fn);
+}
+template<typename Range, typename KeyFn, typename ValueFn, typename Op>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, std::vector<typename detail::group_reduce_map<Range, KeyFn, ValueFn>::type>>::type
+parallel_group_reduce_sharded(Range&& range, const KeyFn& key_fn, const ValueFn& value_fn, const Op& op)
+{
+	return async::parallel_group_reduce_sharded(::async::default_scheduler(), std::forward<Range>(range), key_fn, value_fn, op);
+}
+template<typename Range, typename KeyFn, typename ValueFn, typename Op>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, typename detail::group_reduce_map<Range, KeyFn, ValueFn>::type>::type
+parallel_group_reduce(Range&& range, const KeyFn& key_fn, const ValueFn& value_fn, const Op& op)
+{
+	return async::parallel_group_reduce(::async::default_scheduler(), std::forward<Range>(range), key_fn, value_fn, op);
+}
+
+} // namespace async
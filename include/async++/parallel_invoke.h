@@ -53,18 +53,83 @@ struct parallel_invoke_internal<Index, 0> {
 	static void run(Sched&, const Tuple&) {}
 };
 
+// Detect iterators over callable objects. Function pointers are excluded
+// because they can't be incremented, so a pair of functions is never mistaken
+// for a range.
+template<typename Iter>
+two& is_callable_iterator_helper(typename std::iterator_traits<Iter>::iterator_category*, typename std::decay<decltype(++std::declval<Iter&>())>::type* = nullptr, decltype((*std::declval<Iter&>())())* = nullptr);
+template<typename Iter>
+one& is_callable_iterator_helper(...);
+template<typename Iter>
+struct is_callable_iterator: public std::integral_constant<bool, sizeof(is_callable_iterator_helper<Iter>(nullptr)) - 1> {};
+
+// Detect the arguments of the range overloads of parallel_invoke: a pair of
+// iterators over callable objects and an optional grain size.
+template<typename... Args>
+struct is_invoke_range_args: public std::false_type {};
+template<typename Iter>
+struct is_invoke_range_args<Iter, Iter>: public is_callable_iterator<Iter> {};
+template<typename Iter, typename Grain>
+struct is_invoke_range_args<Iter, Iter, Grain>: public std::integral_constant<bool, is_callable_iterator<Iter>::value && std::is_integral<Grain>::value> {};
+
+// Recursively split a range of functions using a static partitioner, running
+// each chunk sequentially.
+template<typename Sched, typename Partitioner>
+void parallel_invoke_range(Sched& sched, Partitioner partitioner)
+{
+	auto subpart = partitioner.split();
+	if (subpart.begin() == subpart.end()) {
+		for (auto it = partitioner.begin(); it != partitioner.end(); ++it)
+			(*it)();
+		return;
+	}
+
+	auto&& t = async::local_spawn(sched, [&sched, &subpart] {
+		detail::parallel_invoke_range(sched, std::move(subpart));
+	});
+	detail::parallel_invoke_range(sched, std::move(partitioner));
+	t.get();
+}
+
 } // namespace detail
 
 // Run several functions in parallel, optionally using the specified scheduler.
 template<typename Sched, typename... Args>
-typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_invoke(Sched& sched, Args&&... args)
+typename std::enable_if<detail::is_scheduler<Sched>::value && !detail::is_invoke_range_args<typename std::decay<Args>::type...>::value>::type parallel_invoke(Sched& sched, Args&&... args)
 {
 	detail::parallel_invoke_internal<0, sizeof...(Args)>::run(sched, std::forward_as_tuple(std::forward<Args>(args)...));
 }
 template<typename... Args>
-void parallel_invoke(Args&&... args)
+typename std::enable_if<!detail::is_invoke_range_args<typename std::decay<Args>::type...>::value>::type parallel_invoke(Args&&... args)
 {
 	async::parallel_invoke(::async::default_scheduler(), std::forward<Args>(args)...);
 }
 
+// Run a range of functions whose number is only known at runtime in parallel.
+// The range is split recursively without allocating any tasks on the heap.
+// Functions are grouped into chunks of at least grain elements which are run
+// sequentially, which reduces overhead when there are many small functions.
+template<typename Sched, typename Iter, typename Grain>
+typename std::enable_if<detail::is_scheduler<Sched>::value && detail::is_invoke_range_args<Iter, Iter, Grain>::value>::type parallel_invoke(Sched& sched, Iter begin, Iter end, Grain grain)
+{
+	detail::parallel_invoke_range(sched, async::static_partitioner(async::make_range(begin, end), static_cast<std::size_t>(grain)));
+}
+template<typename Sched, typename Iter>
+typename std::enable_if<detail::is_scheduler<Sched>::value && detail::is_callable_iterator<Iter>::value>::type parallel_invoke(Sched& sched, Iter begin, Iter end)
+{
+	async::parallel_invoke(sched, begin, end, std::size_t(1));
+}
+
+// Overloads with default scheduler
+template<typename Iter, typename Grain>
+typename std::enable_if<detail::is_invoke_range_args<Iter, Iter, Grain>::value>::type parallel_invoke(Iter begin, Iter end, Grain grain)
+{
+	async::parallel_invoke(::async::default_scheduler(), begin, end, grain);
+}
+template<typename Iter>
+typename std::enable_if<detail::is_callable_iterator<Iter>::value>::type parallel_invoke(Iter begin, Iter end)
+{
+	async::parallel_invoke(::async::default_scheduler(), begin, end);
+}
+
 } // namespace async
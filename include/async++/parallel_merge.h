@@ -0,0 +1,247 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Determine the size below which ranges are merged sequentially. Like for
+// sorting, we don't go below a minimum size because merging has a higher cost
+// per element than most loop bodies.
+inline std::size_t merge_grain_size(std::size_t dist)
+{
+	std::size_t grain = detail::auto_grain_size(dist);
+	if (grain < 512)
+		grain = 512;
+	return grain;
+}
+
+// Parallel merge of two sorted ranges. The larger range is split in half and
+// the split point in the other range is found using a binary search, which
+// gives two independent merges that can run in parallel. Ties are resolved in
+// favor of the first range, so the merge is stable.
+template<typename Sched, typename Iter1, typename Iter2, typename OutIter, typename Compare>
+void internal_parallel_merge(Sched& sched, Iter1 begin1, Iter1 end1, Iter2 begin2, Iter2 end2, OutIter out, const Compare& comp, std::size_t grain)
+{
+	// Merge sequentially if the range is small enough
+	std::size_t length1 = end1 - begin1;
+	std::size_t length2 = end2 - begin2;
+	if (length1 + length2 <= grain) {
+		std::merge(begin1, end1, begin2, end2, out, comp);
+		return;
+	}
+
+	// Find a split point in both ranges
+	Iter1 mid1;
+	Iter2 mid2;
+	if (length1 >= length2) {
+		mid1 = begin1 + length1 / 2;
+		mid2 = std::lower_bound(begin2, end2, *mid1, comp);
+	} else {
+		mid2 = begin2 + length2 / 2;
+		mid1 = std::upper_bound(begin1, end1, *mid2, comp);
+	}
+	OutIter out_mid = out + ((mid1 - begin1) + (mid2 - begin2));
+
+	// Merge each half in parallel
+	auto&& t = async::local_spawn(sched, [&sched, mid1, end1, mid2, end2, out_mid, &comp, grain] {
+		detail::internal_parallel_merge(sched, mid1, end1, mid2, end2, out_mid, comp, grain);
+	});
+	detail::internal_parallel_merge(sched, begin1, mid1, begin2, mid2, out, comp, grain);
+	t.get();
+}
+
+// Sequential stable merge of any number of sorted ranges. Ties are resolved in
+// favor of the range which comes first.
+template<typename Iter, typename OutIter, typename Compare>
+void sequential_multiway_merge(std::vector<std::pair<Iter, Iter>>& runs, OutIter out, const Compare& comp)
+{
+	// Remove empty ranges, and use simpler algorithms for 1 or 2 ranges
+	runs.erase(std::remove_if(runs.begin(), runs.end(), [](const std::pair<Iter, Iter>& run) {
+		return run.first == run.second;
+	}), runs.end());
+	if (runs.empty())
+		return;
+	if (runs.size() == 1) {
+		std::copy(runs[0].first, runs[0].second, out);
+		return;
+	}
+	if (runs.size() == 2) {
+		std::merge(runs[0].first, runs[0].second, runs[1].first, runs[1].second, out, comp);
+		return;
+	}
+
+	// Use a heap of range indices ordered by the current element of each
+	// range. The heap is a max-heap, so the comparison is reversed.
+	std::vector<std::size_t> heap(runs.size());
+	for (std::size_t i = 0; i < heap.size(); i++)
+		heap[i] = i;
+	auto heap_comp = [&runs, &comp](std::size_t a, std::size_t b) {
+		if (comp(*runs[b].first, *runs[a].first))
+			return true;
+		return !comp(*runs[a].first, *runs[b].first) && b < a;
+	};
+	std::make_heap(heap.begin(), heap.end(), heap_comp);
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), heap_comp);
+		std::pair<Iter, Iter>& run = runs[heap.back()];
+		*out = *run.first;
+		++out;
+		if (++run.first == run.second)
+			heap.pop_back();
+		else
+			std::push_heap(heap.begin(), heap.end(), heap_comp);
+	}
+}
+
+// Parallel stable merge of any number of sorted ranges. The middle element of
+// the longest range is used as a pivot, and the other ranges are split around
+// it using binary searches: elements equal to the pivot go to the first half in
+// ranges before the longest one, and to the second half in ranges after it.
+// This gives two independent merges that can run in parallel.
+template<typename Sched, typename Iter, typename OutIter, typename Compare>
+void internal_parallel_multiway_merge(Sched& sched, std::vector<std::pair<Iter, Iter>> runs, OutIter out, const Compare& comp, std::size_t grain)
+{
+	// Find the total length and the longest range
+	std::size_t total = 0;
+	std::size_t longest = 0;
+	std::size_t longest_length = 0;
+	for (std::size_t i = 0; i < runs.size(); i++) {
+		std::size_t length = runs[i].second - runs[i].first;
+		total += length;
+		if (length > longest_length) {
+			longest = i;
+			longest_length = length;
+		}
+	}
+
+	// Merge sequentially if the ranges are small enough
+	if (total <= grain || longest_length <= 1) {
+		detail::sequential_multiway_merge(runs, out, comp);
+		return;
+	}
+
+	// Split all ranges around the pivot
+	Iter pivot = runs[longest].first + longest_length / 2;
+	std::vector<std::pair<Iter, Iter>> left_runs(runs.size()), right_runs(runs.size());
+	std::size_t left_length = 0;
+	for (std::size_t i = 0; i < runs.size(); i++) {
+		Iter mid;
+		if (i < longest)
+			mid = std::upper_bound(runs[i].first, runs[i].second, *pivot, comp);
+		else if (i > longest)
+			mid = std::lower_bound(runs[i].first, runs[i].second, *pivot, comp);
+		else
+			mid = pivot;
+		left_runs[i] = std::make_pair(runs[i].first, mid);
+		right_runs[i] = std::make_pair(mid, runs[i].second);
+		left_length += mid - runs[i].first;
+	}
+	OutIter out_mid = out + left_length;
+
+	// Merge each half in parallel
+	auto&& t = async::local_spawn(sched, [&sched, &right_runs, out_mid, &comp, grain] {
+		detail::internal_parallel_multiway_merge(sched, std::move(right_runs), out_mid, comp, grain);
+	});
+	detail::internal_parallel_multiway_merge(sched, std::move(left_runs), out, comp, grain);
+	t.get();
+}
+
+} // namespace detail
+
+// Merge two sorted random-access ranges into an output range in parallel. The
+// merge is stable: equivalent elements from the first range come before those
+// from the second. Returns the end of the output range.
+template<typename Sched, typename Range1, typename Range2, typename OutIter, typename Compare>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_merge(Sched& sched, Range1&& range1, Range2&& range2, OutIter out, const Compare& comp)
+{
+	typedef decltype(std::begin(range1)) iterator1;
+	typedef decltype(std::begin(range2)) iterator2;
+	static_assert(std::is_same<typename std::iterator_traits<iterator1>::iterator_category, std::random_access_iterator_tag>::value &&
+	              std::is_same<typename std::iterator_traits<iterator2>::iterator_category, std::random_access_iterator_tag>::value, "parallel_merge requires random-access ranges");
+	static_assert(std::is_same<typename std::iterator_traits<OutIter>::iterator_category, std::random_access_iterator_tag>::value, "parallel_merge requires a random-access output iterator");
+
+	iterator1 begin1 = std::begin(range1);
+	iterator1 end1 = std::end(range1);
+	iterator2 begin2 = std::begin(range2);
+	iterator2 end2 = std::end(range2);
+	std::size_t length = (end1 - begin1) + (end2 - begin2);
+	detail::internal_parallel_merge(sched, begin1, end1, begin2, end2, out, comp, detail::merge_grain_size(length));
+	return out + length;
+}
+
+// Merge any number of sorted random-access ranges into an output range in
+// parallel. The ranges are given as a container of ranges, for example a
+// std::vector of std::vector or of async::range. The merge is stable:
+// equivalent elements are ordered by the position of their range in the
+// container. Returns the end of the output range.
+template<typename Sched, typename Runs, typename OutIter, typename Compare>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_multiway_merge(Sched& sched, Runs&& runs, OutIter out, const Compare& comp)
+{
+	typedef decltype(std::begin(*std::begin(runs))) iterator;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_multiway_merge requires random-access ranges");
+	static_assert(std::is_same<typename std::iterator_traits<OutIter>::iterator_category, std::random_access_iterator_tag>::value, "parallel_multiway_merge requires a random-access output iterator");
+
+	std::vector<std::pair<iterator, iterator>> run_iters;
+	std::size_t length = 0;
+	for (auto&& run: runs) {
+		run_iters.push_back(std::make_pair(std::begin(run), std::end(run)));
+		length += run_iters.back().second - run_iters.back().first;
+	}
+	detail::internal_parallel_multiway_merge(sched, std::move(run_iters), out, comp, detail::merge_grain_size(length));
+	return out + length;
+}
+
+// Overloads with default comparator and default scheduler
+template<typename Sched, typename Range1, typename Range2, typename OutIter>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_merge(Sched& sched, Range1&& range1, Range2&& range2, OutIter out)
+{
+	return async::parallel_merge(sched, std::forward<Range1>(range1), std::forward<Range2>(range2), out, std::less<typename std::iterator_traits<decltype(std::begin(range1))>::value_type>());
+}
+template<typename Range1, typename Range2, typename OutIter, typename Compare>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range1>::type>::value, OutIter>::type parallel_merge(Range1&& range1, Range2&& range2, OutIter out, const Compare& comp)
+{
+	return async::parallel_merge(::async::default_scheduler(), std::forward<Range1>(range1), std::forward<Range2>(range2), out, comp);
+}
+template<typename Range1, typename Range2, typename OutIter>
+OutIter parallel_merge(Range1&& range1, Range2&& range2, OutIter out)
+{
+	return async::parallel_merge(::async::default_scheduler(), std::forward<Range1>(range1), std::forward<Range2>(range2), out);
+}
+template<typename Sched, typename Runs, typename OutIter>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_multiway_merge(Sched& sched, Runs&& runs, OutIter out)
+{
+	return async::parallel_multiway_merge(sched, std::forward<Runs>(runs), out, std::less<typename std::iterator_traits<decltype(std::begin(*std::begin(runs)))>::value_type>());
+}
+template<typename Runs, typename OutIter, typename Compare>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Runs>::type>::value, OutIter>::type parallel_multiway_merge(Runs&& runs, OutIter out, const Compare& comp)
+{
+	return async::parallel_multiway_merge(::async::default_scheduler(), std::forward<Runs>(runs), out, comp);
+}
+template<typename Runs, typename OutIter>
+OutIter parallel_multiway_merge(Runs&& runs, OutIter out)
+{
+	return async::parallel_multiway_merge(::async::default_scheduler(), std::forward<Runs>(runs), out);
+}
+
+} // namespace async
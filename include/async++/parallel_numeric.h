@@ -0,0 +1,271 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Vectorized kernels for contiguous arrays of float, double and int. These use
+// the best instruction set supported by the CPU, which is detected at runtime.
+// The portable kernels add elements in the same order as the vectorized ones,
+// so floating-point results don't depend on the CPU. simd_minmax requires a
+// non-empty array.
+LIBASYNC_EXPORT float simd_sum(const float* data, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT double simd_sum(const double* data, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT int simd_sum(const int* data, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT void simd_minmax(const float* data, std::size_t length, float& min, float& max) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT void simd_minmax(const double* data, std::size_t length, double& min, double& max) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT void simd_minmax(const int* data, std::size_t length, int& min, int& max) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT float simd_dot(const float* a, const float* b, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT double simd_dot(const double* a, const double* b, std::size_t length) LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT int simd_dot(const int* a, const int* b, std::size_t length) LIBASYNC_NOEXCEPT;
+
+// Check whether the vectorized kernels can be used for a range
+template<typename Iter>
+struct has_simd_kernel: public std::integral_constant<bool, is_contiguous_iterator<Iter>::value &&
+	(std::is_same<typename std::iterator_traits<Iter>::value_type, float>::value ||
+	 std::is_same<typename std::iterator_traits<Iter>::value_type, double>::value ||
+	 std::is_same<typename std::iterator_traits<Iter>::value_type, int>::value)> {};
+
+// Sum the elements of a chunk
+template<typename Iter>
+typename std::iterator_traits<Iter>::value_type sum_chunk(Iter begin, Iter end, std::false_type)
+{
+	typename std::iterator_traits<Iter>::value_type out = typename std::iterator_traits<Iter>::value_type();
+	for (; begin != end; ++begin)
+		out = std::move(out) + *begin;
+	return out;
+}
+template<typename Iter>
+typename std::iterator_traits<Iter>::value_type sum_chunk(Iter begin, Iter end, std::true_type)
+{
+	if (begin == end)
+		return typename std::iterator_traits<Iter>::value_type();
+	return detail::simd_sum(detail::to_pointer(begin), end - begin);
+}
+
+// Find the minimum and maximum of a non-empty chunk
+template<typename Iter, typename T>
+void minmax_chunk(Iter begin, Iter end, T& min, T& max, std::false_type)
+{
+	min = *begin;
+	max = *begin;
+	for (++begin; begin != end; ++begin) {
+		if (*begin < min)
+			min = *begin;
+		if (max < *begin)
+			max = *begin;
+	}
+}
+template<typename Iter, typename T>
+void minmax_chunk(Iter begin, Iter end, T& min, T& max, std::true_type)
+{
+	detail::simd_minmax(detail::to_pointer(begin), end - begin, min, max);
+}
+
+// Dot product of a chunk and the matching elements of a second range
+template<typename Iter1, typename Iter2>
+typename std::iterator_traits<Iter1>::value_type dot_chunk(Iter1 begin1, Iter1 end1, Iter2 begin2, std::false_type)
+{
+	typename std::iterator_traits<Iter1>::value_type out = typename std::iterator_traits<Iter1>::value_type();
+	for (; begin1 != end1; ++begin1, ++begin2)
+		out = std::move(out) + *begin1 * *begin2;
+	return out;
+}
+template<typename Iter1, typename Iter2>
+typename std::iterator_traits<Iter1>::value_type dot_chunk(Iter1 begin1, Iter1 end1, Iter2 begin2, std::true_type)
+{
+	if (begin1 == end1)
+		return typename std::iterator_traits<Iter1>::value_type();
+	return detail::simd_dot(detail::to_pointer(begin1), detail::to_pointer(begin2), end1 - begin1);
+}
+
+// Count the elements of a chunk matching a predicate. The loop over contiguous
+// memory is written without branches so that the compiler can vectorize it.
+template<typename Iter, typename Pred>
+std::size_t count_chunk(Iter begin, Iter end, const Pred& pred, std::false_type)
+{
+	std::size_t count = 0;
+	for (; begin != end; ++begin)
+		count += pred(*begin) ? 1 : 0;
+	return count;
+}
+template<typename Iter, typename Pred>
+std::size_t count_chunk(Iter begin, Iter end, const Pred& pred, std::true_type)
+{
+	std::size_t length = end - begin;
+	if (length == 0)
+		return 0;
+	auto ptr = detail::to_pointer(begin);
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < length; i++)
+		count += pred(ptr[i]) ? 1 : 0;
+	return count;
+}
+
+// Leaf functions for parallel_map_reduce_chunked
+template<typename T>
+struct sum_leaf {
+	template<typename Chunk>
+	T operator()(const Chunk& chunk, T out) const
+	{
+		typedef decltype(chunk.begin()) iterator;
+		return std::move(out) + detail::sum_chunk(chunk.begin(), chunk.end(), has_simd_kernel<iterator>());
+	}
+};
+
+// Partial result of parallel_minmax, which is empty for empty chunks
+template<typename T>
+struct minmax_result {
+	bool valid;
+	T min, max;
+};
+template<typename T>
+struct minmax_reduce {
+	minmax_result<T> operator()(minmax_result<T> a, minmax_result<T> b) const
+	{
+		if (!a.valid)
+			return b;
+		if (!b.valid)
+			return a;
+		if (b.min < a.min)
+			a.min = std::move(b.min);
+		if (a.max < b.max)
+			a.max = std::move(b.max);
+		return a;
+	}
+};
+template<typename T>
+struct minmax_leaf {
+	template<typename Chunk>
+	minmax_result<T> operator()(const Chunk& chunk, minmax_result<T> out) const
+	{
+		typedef decltype(chunk.begin()) iterator;
+		if (chunk.begin() == chunk.end())
+			return out;
+		minmax_result<T> result = {true, T(), T()};
+		detail::minmax_chunk(chunk.begin(), chunk.end(), result.min, result.max, has_simd_kernel<iterator>());
+		return minmax_reduce<T>()(std::move(out), std::move(result));
+	}
+};
+
+template<typename T, typename Iter1, typename Iter2>
+struct dot_leaf {
+	Iter1 begin1;
+	Iter2 begin2;
+
+	template<typename Chunk>
+	T operator()(const Chunk& chunk, T out) const
+	{
+		typedef std::integral_constant<bool, has_simd_kernel<Iter1>::value && has_simd_kernel<Iter2>::value &&
+			std::is_same<typename std::iterator_traits<Iter1>::value_type, typename std::iterator_traits<Iter2>::value_type>::value> vectorize;
+		Iter2 chunk_begin2 = begin2;
+		std::advance(chunk_begin2, std::distance(begin1, chunk.begin()));
+		return std::move(out) + detail::dot_chunk(chunk.begin(), chunk.end(), chunk_begin2, vectorize());
+	}
+};
+
+template<typename Pred>
+struct count_leaf {
+	const Pred& pred;
+
+	template<typename Chunk>
+	std::size_t operator()(const Chunk& chunk, std::size_t out) const
+	{
+		typedef decltype(chunk.begin()) iterator;
+		return out + detail::count_chunk(chunk.begin(), chunk.end(), pred, is_contiguous_iterator<iterator>());
+	}
+};
+
+} // namespace detail
+
+// Sum the elements of a range. Chunks of contiguous float, double and int
+// ranges are summed using vectorized kernels. Partial sums are added in a
+// different order than in a sequential loop, so floating-point results may be
+// slightly different from std::accumulate. The order doesn't depend on the
+// CPU, so with deterministic_partitioner the result is reproducible.
+template<typename Sched, typename Range>
+typename std::enable_if<detail::is_scheduler<Sched>::value, typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type>::type parallel_sum(Sched& sched, Range&& range)
+{
+	typedef typename std::iterator_traits<decltype(std::begin(range))>::value_type value_type;
+	return async::parallel_map_reduce_chunked(sched, std::forward<Range>(range), value_type(), detail::sum_leaf<value_type>(), std::plus<value_type>());
+}
+
+// Find the smallest and largest elements of a non-empty range. Chunks of
+// contiguous float, double and int ranges are processed using vectorized
+// kernels, for which the result is unspecified if the range contains NaNs.
+template<typename Sched, typename Range>
+typename std::enable_if<detail::is_scheduler<Sched>::value, std::pair<typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type, typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type>>::type parallel_minmax(Sched& sched, Range&& range)
+{
+	typedef typename std::iterator_traits<decltype(std::begin(range))>::value_type value_type;
+	LIBASYNC_ASSERT(std::begin(range) != std::end(range), std::invalid_argument, "parallel_minmax called on an empty range");
+	detail::minmax_result<value_type> init = {false, value_type(), value_type()};
+	detail::minmax_result<value_type> result = async::parallel_map_reduce_chunked(sched, std::forward<Range>(range), init, detail::minmax_leaf<value_type>(), detail::minmax_reduce<value_type>());
+	return std::make_pair(std::move(result.min), std::move(result.max));
+}
+
+// Compute the dot product of a range and a second sequence of at least the
+// same length. Vectorized kernels are used if both are contiguous ranges of the
+// same type, which must be float, double or int. Both must be random-access,
+// since each chunk looks up its position in the second sequence.
+template<typename Sched, typename Range, typename Iter2>
+typename std::enable_if<detail::is_scheduler<Sched>::value, typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type>::type parallel_dot(Sched& sched, Range&& range, Iter2 begin2)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_dot requires a random-access range");
+	static_assert(std::is_same<typename std::iterator_traits<Iter2>::iterator_category, std::random_access_iterator_tag>::value, "parallel_dot requires a random-access second sequence");
+	detail::dot_leaf<value_type, iterator, Iter2> leaf = {std::begin(range), begin2};
+	return async::parallel_map_reduce_chunked(sched, std::forward<Range>(range), value_type(), leaf, std::plus<value_type>());
+}
+
+// Count the elements of a range for which a predicate returns true
+template<typename Sched, typename Range, typename Pred>
+typename std::enable_if<detail::is_scheduler<Sched>::value, std::size_t>::type parallel_count_if(Sched& sched, Range&& range, const Pred& pred)
+{
+	return async::parallel_map_reduce_chunked(sched, std::forward<Range>(range), std::size_t(0), detail::count_leaf<Pred>{pred}, std::plus<std::size_t>());
+}
+
+// Overloads with default scheduler
+template<typename Range>
+typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type parallel_sum(Range&& range)
+{
+	return async::parallel_sum(::async::default_scheduler(), std::forward<Range>(range));
+}
+template<typename Range>
+std::pair<typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type, typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type> parallel_minmax(Range&& range)
+{
+	return async::parallel_minmax(::async::default_scheduler(), std::forward<Range>(range));
+}
+template<typename Range, typename Iter2>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, typename std::iterator_traits<decltype(std::begin(std::declval<Range>()))>::value_type>::type parallel_dot(Range&& range, Iter2 begin2)
+{
+	return async::parallel_dot(::async::default_scheduler(), std::forward<Range>(range), begin2);
+}
+template<typename Range, typename Pred>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, std::size_t>::type parallel_count_if(Range&& range, const Pred& pred)
+{
+	return async::parallel_count_if(::async::default_scheduler(), std::forward<Range>(range), pred);
+}
+
+} // namespace async
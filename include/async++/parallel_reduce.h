@@ -35,34 +35,210 @@ struct default_map {
 };
 
 // Internal implementation of parallel_map_reduce that only accepts a
-// partitioner argument.
+// partitioner argument. Elements are accumulated into out, while init is the
+// initial value used for partitions which are split off into separate tasks.
 template<typename Sched, typename Partitioner, typename Result, typename MapFunc, typename ReduceFunc>
-Result internal_parallel_map_reduce(Sched& sched, Partitioner partitioner, Result init, const MapFunc& map, const ReduceFunc& reduce)
+Result internal_parallel_map_reduce(Sched& sched, Partitioner partitioner, Result out, const Result& init, const MapFunc& map, const ReduceFunc& reduce)
 {
-	// Split the partition, run inline if no more splits are possible
+	// Split the partition, processing deferred partitions inline (see
+	// internal_parallel_for).
 	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		for (auto&& i: partitioner)
+			out = reduce(std::move(out), map(std::forward<decltype(i)>(i)));
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Run inline if no more splits are possible
 	if (subpart.begin() == subpart.end()) {
-		Result out = init;
 		for (auto&& i: partitioner)
 			out = reduce(std::move(out), map(std::forward<decltype(i)>(i)));
 		return out;
 	}
 
 	// Run the function over each half in parallel
-	auto&& t = async::local_spawn(sched, [&sched, &subpart, init, &map, &reduce] {
-		return detail::internal_parallel_map_reduce(sched, std::move(subpart), init, map, reduce);
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &init, &map, &reduce] {
+		return detail::internal_parallel_map_reduce(sched, std::move(subpart), init, init, map, reduce);
+	});
+	out = detail::internal_parallel_map_reduce(sched, std::move(partitioner), std::move(out), init, map, reduce);
+	return reduce(std::move(out), t.get());
+}
+
+// Internal implementation of parallel_map_reduce_chunked that only accepts a
+// partitioner argument. The out and init parameters are used in the same way
+// as in internal_parallel_map_reduce.
+template<typename Sched, typename Partitioner, typename Result, typename MapFunc, typename ReduceFunc>
+Result internal_parallel_map_reduce_chunked(Sched& sched, Partitioner partitioner, Result out, const Result& init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	// Split the partition, processing deferred partitions inline (see
+	// internal_parallel_for).
+	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		if (!detail::partition_empty(partitioner))
+			out = map(detail::partition_chunk(partitioner), std::move(out));
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Map the whole chunk if no more splits are possible. Empty chunks are
+	// skipped, like in parallel_for_chunked.
+	if (detail::partition_empty(subpart)) {
+		if (detail::partition_empty(partitioner))
+			return out;
+		return map(detail::partition_chunk(partitioner), std::move(out));
+	}
+
+	// Run the function over each half in parallel
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &init, &map, &reduce] {
+		return detail::internal_parallel_map_reduce_chunked(sched, std::move(subpart), init, init, map, reduce);
 	});
-	Result out = detail::internal_parallel_map_reduce(sched, std::move(partitioner), init, map, reduce);
+	out = detail::internal_parallel_map_reduce_chunked(sched, std::move(partitioner), std::move(out), init, map, reduce);
 	return reduce(std::move(out), t.get());
 }
 
+// Blocked ranges have no elements to iterate over, so parallel_map_reduce
+// maps each block to a result, which is then reduced like a chunk result of
+// parallel_map_reduce_chunked.
+template<typename MapFunc, typename ReduceFunc>
+struct blocked_map_reduce_leaf {
+	const MapFunc& map;
+	const ReduceFunc& reduce;
+
+	template<typename Block, typename Result>
+	Result operator()(const Block& block, Result out) const
+	{
+		return reduce(std::move(out), map(block));
+	}
+};
+template<typename Sched, typename RowValue, typename ColValue, typename Result, typename MapFunc, typename ReduceFunc>
+Result internal_parallel_map_reduce(Sched& sched, blocked_range2d<RowValue, ColValue> partitioner, Result out, const Result& init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return detail::internal_parallel_map_reduce_chunked(sched, std::move(partitioner), std::move(out), init, blocked_map_reduce_leaf<MapFunc, ReduceFunc>{map, reduce}, reduce);
+}
+template<typename Sched, typename PageValue, typename RowValue, typename ColValue, typename Result, typename MapFunc, typename ReduceFunc>
+Result internal_parallel_map_reduce(Sched& sched, blocked_range3d<PageValue, RowValue, ColValue> partitioner, Result out, const Result& init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return detail::internal_parallel_map_reduce_chunked(sched, std::move(partitioner), std::move(out), init, blocked_map_reduce_leaf<MapFunc, ReduceFunc>{map, reduce}, reduce);
+}
+
+// Node in the reduction tree of parallel_map_reduce_async. A node is created
+// when a partition is split, and holds the results of both halves until they
+// are both available. The combined result is then written to the output slot
+// of the parent node.
+template<typename Result>
+struct reduce_join_node {
+	reduce_join_node* parent;
+	Result* out;
+	Result left, right;
+	std::atomic<int> remaining;
+
+	reduce_join_node(reduce_join_node* parent_, Result* out_, Result&& left_, const Result& right_)
+		: parent(parent_), out(out_), left(std::move(left_)), right(right_), remaining(2) {}
+};
+
+// Shared state of a parallel_map_reduce_async call, see parallel_for_async_state
+template<typename Sched, typename Result, typename MapFunc, typename ReduceFunc>
+struct parallel_map_reduce_async_state {
+	typedef reduce_join_node<Result> node;
+
+	Sched& sched;
+	Result init;
+	MapFunc map;
+	ReduceFunc reduce;
+	Result result;
+	event_task<Result> event;
+	std::atomic<bool> failed;
+	std::exception_ptr except;
+
+	parallel_map_reduce_async_state(Sched& sched_, const Result& init_, MapFunc map_, ReduceFunc reduce_)
+		: sched(sched_), init(init_), map(std::move(map_)), reduce(std::move(reduce_)), result(init_), failed(false) {}
+
+	void set_exception(std::exception_ptr except_)
+	{
+		if (!failed.exchange(true, std::memory_order_relaxed))
+			except = std::move(except_);
+	}
+
+	// Called when a task has written the result of its partition into one of
+	// the slots of a join node, or into the final result if the node is null.
+	// The last task to finish for a node combines the two halves and moves on
+	// to the parent node.
+	void finish(node* n)
+	{
+		while (n) {
+			if (n->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			if (!failed.load(std::memory_order_relaxed)) {
+				LIBASYNC_TRY {
+					*n->out = reduce(std::move(n->left), std::move(n->right));
+				} LIBASYNC_CATCH(...) {
+					set_exception(std::current_exception());
+				}
+			}
+			node* parent = n->parent;
+			delete n;
+			n = parent;
+		}
+		if (failed.load(std::memory_order_relaxed))
+			event.set_exception(std::move(except));
+		else
+			event.set(std::move(result));
+	}
+};
+
+// Process a partition for parallel_map_reduce_async, accumulating into out.
+// When the partition is split, the first half keeps accumulating into the
+// value we already have, while the second half starts from init in a new task.
+template<typename State, typename Partitioner, typename Result>
+void parallel_map_reduce_async_run(const std::shared_ptr<State>& state, Partitioner partitioner, Result* out, typename State::node* parent)
+{
+	LIBASYNC_TRY {
+		auto subpart = partitioner.split();
+		while (!state->failed.load(std::memory_order_relaxed)) {
+			// Process deferred and unsplittable partitions inline
+			if (detail::partition_deferred(subpart, 0) || subpart.begin() == subpart.end()) {
+				for (auto&& i: partitioner)
+					*out = state->reduce(std::move(*out), state->map(std::forward<decltype(i)>(i)));
+				if (subpart.begin() == subpart.end())
+					break;
+				partitioner = std::move(subpart);
+				subpart = partitioner.split();
+				continue;
+			}
+
+			// Spawn a task for the second half
+			typename State::node* join = new typename State::node(parent, out, std::move(*out), state->init);
+			LIBASYNC_TRY {
+				auto&& subpart_sched = detail::partition_scheduler(state->sched, subpart);
+				async::spawn(subpart_sched, [state, subpart, join] {
+					detail::parallel_map_reduce_async_run(state, subpart, &join->right, join);
+				});
+			} LIBASYNC_CATCH(...) {
+				state->set_exception(std::current_exception());
+				state->finish(join);
+			}
+			out = &join->left;
+			parent = join;
+			subpart = partitioner.split();
+		}
+	} LIBASYNC_CATCH(...) {
+		state->set_exception(std::current_exception());
+	}
+	state->finish(parent);
+}
+
 } // namespace detail
 
-// Run a function for each element in a range and then reduce the results of that function to a single value
+// Run a function for each element in a range and then reduce the results of that function to a single value.
+// Partial results are always reduced in index order, so the result is reproducible if the partitioner splits the
+// range the same way every time, as deterministic_partitioner does.
 template<typename Sched, typename Range, typename Result, typename MapFunc, typename ReduceFunc>
 Result parallel_map_reduce(Sched& sched, Range&& range, Result init, const MapFunc& map, const ReduceFunc& reduce)
 {
-	return detail::internal_parallel_map_reduce(sched, async::to_partitioner(std::forward<Range>(range)), init, map, reduce);
+	return detail::internal_parallel_map_reduce(sched, async::to_partitioner(std::forward<Range>(range)), init, init, map, reduce);
 }
 
 // Overload with default scheduler
@@ -106,4 +282,65 @@ Result parallel_reduce(std::initializer_list<T> range, Result init, const Reduce
 	return async::parallel_reduce(async::make_range(range.begin(), range.end()), init, reduce);
 }
 
+// Asynchronous versions of parallel_map_reduce and parallel_reduce which return
+// immediately. The returned task completes with the result of the reduction,
+// or with the first exception thrown by the map or reduce functions. Partial
+// results are still reduced in index order. The functions are copied, and the
+// range must remain valid until the task completes. Instead of waiting for
+// each other, the tasks processing the range combine partial results in
+// reduce_join_node objects, so no thread is ever blocked.
+template<typename Sched, typename Range, typename Result, typename MapFunc, typename ReduceFunc>
+task<Result> parallel_map_reduce_async(Sched& sched, Range&& range, Result init, MapFunc&& map, ReduceFunc&& reduce)
+{
+	typedef detail::parallel_map_reduce_async_state<Sched, Result, typename std::decay<MapFunc>::type, typename std::decay<ReduceFunc>::type> state_type;
+	std::shared_ptr<state_type> state = std::make_shared<state_type>(sched, init, std::forward<MapFunc>(map), std::forward<ReduceFunc>(reduce));
+	task<Result> out = state->event.get_task();
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	async::spawn(sched, [state, partitioner] {
+		detail::parallel_map_reduce_async_run(state, partitioner, &state->result, static_cast<typename state_type::node*>(nullptr));
+	});
+	return out;
+}
+template<typename Range, typename Result, typename MapFunc, typename ReduceFunc>
+task<Result> parallel_map_reduce_async(Range&& range, Result init, MapFunc&& map, ReduceFunc&& reduce)
+{
+	return async::parallel_map_reduce_async(::async::default_scheduler(), std::forward<Range>(range), init, std::forward<MapFunc>(map), std::forward<ReduceFunc>(reduce));
+}
+template<typename Sched, typename Range, typename Result, typename ReduceFunc>
+task<Result> parallel_reduce_async(Sched& sched, Range&& range, Result init, ReduceFunc&& reduce)
+{
+	return async::parallel_map_reduce_async(sched, std::forward<Range>(range), init, detail::default_map(), std::forward<ReduceFunc>(reduce));
+}
+template<typename Range, typename Result, typename ReduceFunc>
+task<Result> parallel_reduce_async(Range&& range, Result init, ReduceFunc&& reduce)
+{
+	return async::parallel_reduce_async(::async::default_scheduler(), std::forward<Range>(range), init, std::forward<ReduceFunc>(reduce));
+}
+
+// Chunk-level variant of parallel_map_reduce. The map function is called once
+// per non-empty chunk with an async::range covering the chunk and a copy of
+// init, and returns the result for the whole chunk, which allows it to
+// accumulate into a local variable. Chunk results are then combined using the
+// reduce function, and an empty range returns init.
+template<typename Sched, typename Range, typename Result, typename MapFunc, typename ReduceFunc>
+Result parallel_map_reduce_chunked(Sched& sched, Range&& range, Result init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return detail::internal_parallel_map_reduce_chunked(sched, async::to_partitioner(std::forward<Range>(range)), init, init, map, reduce);
+}
+template<typename Range, typename Result, typename MapFunc, typename ReduceFunc>
+Result parallel_map_reduce_chunked(Range&& range, Result init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return async::parallel_map_reduce_chunked(::async::default_scheduler(), range, init, map, reduce);
+}
+template<typename Sched, typename T, typename Result, typename MapFunc, typename ReduceFunc>
+Result parallel_map_reduce_chunked(Sched& sched, std::initializer_list<T> range, Result init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return async::parallel_map_reduce_chunked(sched, async::make_range(range.begin(), range.end()), init, map, reduce);
+}
+template<typename T, typename Result, typename MapFunc, typename ReduceFunc>
+Result parallel_map_reduce_chunked(std::initializer_list<T> range, Result init, const MapFunc& map, const ReduceFunc& reduce)
+{
+	return async::parallel_map_reduce_chunked(async::make_range(range.begin(), range.end()), init, map, reduce);
+}
+
 } // namespace async
@@ -0,0 +1,209 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Determine the size below which a range is sorted sequentially. Sorting has a
+// much higher cost per element than most loop bodies so we don't go below a
+// minimum size even if there are many threads.
+inline std::size_t sort_grain_size(std::size_t dist)
+{
+	std::size_t grain = detail::auto_grain_size(dist);
+	if (grain < 512)
+		grain = 512;
+	return grain;
+}
+
+// Parallel quicksort. Each level partitions the range into elements less than,
+// equal to and greater than a median-of-3 pivot, and the outer parts are sorted
+// in parallel. If the recursion gets too deep because of bad pivots then we
+// fall back to std::sort, which guarantees O(n log n) like introsort.
+template<typename Sched, typename Iter, typename Compare>
+void internal_parallel_sort(Sched& sched, Iter begin, Iter end, const Compare& comp, std::size_t grain, std::size_t depth)
+{
+	typedef typename std::iterator_traits<Iter>::value_type value_type;
+
+	// Sort sequentially if the range is small enough
+	std::size_t length = end - begin;
+	if (length <= grain || depth == 0) {
+		std::sort(begin, end, comp);
+		return;
+	}
+
+	// Move the median of the first, middle and last elements to the front
+	Iter mid = begin + length / 2;
+	Iter last = end - 1;
+	if (comp(*mid, *begin))
+		std::iter_swap(mid, begin);
+	if (comp(*last, *mid)) {
+		std::iter_swap(last, mid);
+		if (comp(*mid, *begin))
+			std::iter_swap(mid, begin);
+	}
+	std::iter_swap(begin, mid);
+
+	// Partition the elements less than the pivot and then move the pivot into
+	// its final position.
+	Iter pivot = std::partition(begin + 1, end, [begin, &comp](const value_type& x) {
+		return comp(x, *begin);
+	}) - 1;
+	std::iter_swap(begin, pivot);
+
+	// Skip over all elements equal to the pivot, which avoids quadratic
+	// behavior for ranges with many duplicate keys.
+	Iter right = std::partition(pivot + 1, end, [pivot, &comp](const value_type& x) {
+		return !comp(*pivot, x);
+	});
+
+	// Sort each side in parallel
+	auto&& t = async::local_spawn(sched, [&sched, right, end, &comp, grain, depth] {
+		detail::internal_parallel_sort(sched, right, end, comp, grain, depth - 1);
+	});
+	detail::internal_parallel_sort(sched, begin, pivot, comp, grain, depth - 1);
+	t.get();
+}
+
+// Parallel merge sort which alternates between the input range and a scratch
+// buffer of the same size. If into_dest is true then the sorted result of
+// [begin, end) is placed in the destination range, otherwise it is left in
+// [begin, end).
+template<typename Sched, typename Iter, typename DestIter, typename Compare>
+void internal_parallel_stable_sort(Sched& sched, Iter begin, Iter end, DestIter dest, const Compare& comp, std::size_t grain, bool into_dest)
+{
+	// Sort sequentially if the range is small enough
+	std::size_t length = end - begin;
+	if (length <= grain) {
+		std::stable_sort(begin, end, comp);
+		if (into_dest)
+			std::move(begin, end, dest);
+		return;
+	}
+
+	// Sort each half in parallel, placing the results in the opposite range
+	// to the one we want to merge into.
+	Iter mid = begin + length / 2;
+	DestIter dest_mid = dest + length / 2;
+	DestIter dest_end = dest + length;
+	{
+		auto&& t = async::local_spawn(sched, [&sched, mid, end, dest_mid, &comp, grain, into_dest] {
+			detail::internal_parallel_stable_sort(sched, mid, end, dest_mid, comp, grain, !into_dest);
+		});
+		detail::internal_parallel_stable_sort(sched, begin, mid, dest, comp, grain, !into_dest);
+		t.get();
+	}
+
+	// Merge the two halves
+	if (into_dest)
+		detail::internal_parallel_merge(sched, std::make_move_iterator(begin), std::make_move_iterator(mid), std::make_move_iterator(mid), std::make_move_iterator(end), dest, comp, grain);
+	else
+		detail::internal_parallel_merge(sched, std::make_move_iterator(dest), std::make_move_iterator(dest_mid), std::make_move_iterator(dest_mid), std::make_move_iterator(dest_end), begin, comp, grain);
+}
+
+// Maximum recursion depth for parallel quicksort: 2 * log2(n)
+inline std::size_t sort_depth_limit(std::size_t length)
+{
+	std::size_t depth = 0;
+	while (length > 1) {
+		depth += 2;
+		length /= 2;
+	}
+	return depth;
+}
+
+} // namespace detail
+
+// Sort a random-access range in parallel. The sort is not stable.
+template<typename Sched, typename Range, typename Compare>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_sort(Sched& sched, Range&& range, const Compare& comp)
+{
+	typedef decltype(std::begin(range)) iterator;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_sort requires a random-access range");
+
+	iterator begin = std::begin(range);
+	iterator end = std::end(range);
+	std::size_t length = end - begin;
+	detail::internal_parallel_sort(sched, begin, end, comp, detail::sort_grain_size(length), detail::sort_depth_limit(length));
+}
+
+// Overloads with default comparator and default scheduler
+template<typename Sched, typename Range>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_sort(Sched& sched, Range&& range)
+{
+	async::parallel_sort(sched, range, std::less<typename std::iterator_traits<decltype(std::begin(range))>::value_type>());
+}
+template<typename Range, typename Compare>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value>::type parallel_sort(Range&& range, const Compare& comp)
+{
+	async::parallel_sort(::async::default_scheduler(), range, comp);
+}
+template<typename Range>
+void parallel_sort(Range&& range)
+{
+	async::parallel_sort(::async::default_scheduler(), range);
+}
+
+// Sort a random-access range in parallel, preserving the relative order of
+// equivalent elements. This uses a scratch buffer of the same size as the
+// range, which is the only allocation made.
+template<typename Sched, typename Range, typename Compare>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_stable_sort(Sched& sched, Range&& range, const Compare& comp)
+{
+	typedef decltype(std::begin(range)) iterator;
+	typedef typename std::iterator_traits<iterator>::value_type value_type;
+	static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, "parallel_stable_sort requires a random-access range");
+
+	iterator begin = std::begin(range);
+	iterator end = std::end(range);
+	std::size_t length = end - begin;
+	std::size_t grain = detail::sort_grain_size(length);
+	if (length <= grain) {
+		std::stable_sort(begin, end, comp);
+		return;
+	}
+
+	// Move the elements into the scratch buffer and sort from there back into
+	// the original range. This way all elements always remain constructed.
+	std::vector<value_type> buffer(std::make_move_iterator(begin), std::make_move_iterator(end));
+	detail::internal_parallel_stable_sort(sched, buffer.begin(), buffer.end(), begin, comp, grain, true);
+}
+
+// Overloads with default comparator and default scheduler
+template<typename Sched, typename Range>
+typename std::enable_if<detail::is_scheduler<Sched>::value>::type parallel_stable_sort(Sched& sched, Range&& range)
+{
+	async::parallel_stable_sort(sched, range, std::less<typename std::iterator_traits<decltype(std::begin(range))>::value_type>());
+}
+template<typename Range, typename Compare>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value>::type parallel_stable_sort(Range&& range, const Compare& comp)
+{
+	async::parallel_stable_sort(::async::default_scheduler(), range, comp);
+}
+template<typename Range>
+void parallel_stable_sort(Range&& range)
+{
+	async::parallel_stable_sort(::async::default_scheduler(), range);
+}
+
+} // namespace async
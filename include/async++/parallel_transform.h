@@ -0,0 +1,261 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Apply a unary function to a chunk of elements. If both input and output are
+// contiguous then the loop is done on raw pointers so that the compiler can
+// vectorize it.
+template<typename InIter, typename OutIter, typename Func>
+void transform_chunk(InIter begin, InIter end, OutIter out, const Func& func, std::false_type)
+{
+	for (; begin != end; ++begin, ++out)
+		*out = func(*begin);
+}
+template<typename InIter, typename OutIter, typename Func>
+void transform_chunk(InIter begin, InIter end, OutIter out, const Func& func, std::true_type)
+{
+	std::size_t length = end - begin;
+	if (length == 0)
+		return;
+	auto in_ptr = detail::to_pointer(begin);
+	auto out_ptr = detail::to_pointer(out);
+	for (std::size_t i = 0; i < length; i++)
+		out_ptr[i] = func(in_ptr[i]);
+}
+
+// Same as above, for binary functions
+template<typename InIter1, typename InIter2, typename OutIter, typename Func>
+void transform_chunk(InIter1 begin1, InIter1 end1, InIter2 begin2, OutIter out, const Func& func, std::false_type)
+{
+	for (; begin1 != end1; ++begin1, ++begin2, ++out)
+		*out = func(*begin1, *begin2);
+}
+template<typename InIter1, typename InIter2, typename OutIter, typename Func>
+void transform_chunk(InIter1 begin1, InIter1 end1, InIter2 begin2, OutIter out, const Func& func, std::true_type)
+{
+	std::size_t length = end1 - begin1;
+	if (length == 0)
+		return;
+	auto in_ptr1 = detail::to_pointer(begin1);
+	auto in_ptr2 = detail::to_pointer(begin2);
+	auto out_ptr = detail::to_pointer(out);
+	for (std::size_t i = 0; i < length; i++)
+		out_ptr[i] = func(in_ptr1[i], in_ptr2[i]);
+}
+
+// Leaf functions for unary and binary transforms. These are called with a
+// chunk of the first input range and a cursor holding the iterators of the
+// other ranges which line up with the start of that chunk. advance() moves a
+// cursor forward by a number of elements.
+template<typename OutIter, typename Func>
+struct unary_transform_leaf {
+	typedef OutIter cursor;
+	const Func& func;
+
+	template<typename InIter>
+	void operator()(InIter begin, InIter end, OutIter out) const
+	{
+		typedef std::integral_constant<bool, is_contiguous_iterator<InIter>::value && is_contiguous_iterator<OutIter>::value> contiguous;
+		detail::transform_chunk(begin, end, out, func, contiguous());
+	}
+	static OutIter advance(OutIter out, std::size_t count)
+	{
+		std::advance(out, count);
+		return out;
+	}
+};
+template<typename InIter2, typename OutIter, typename Func>
+struct binary_transform_leaf {
+	typedef std::pair<InIter2, OutIter> cursor;
+	const Func& func;
+
+	template<typename InIter1>
+	void operator()(InIter1 begin, InIter1 end, const cursor& pos) const
+	{
+		typedef std::integral_constant<bool, is_contiguous_iterator<InIter1>::value && is_contiguous_iterator<InIter2>::value && is_contiguous_iterator<OutIter>::value> contiguous;
+		detail::transform_chunk(begin, end, pos.first, pos.second, func, contiguous());
+	}
+	static cursor advance(cursor pos, std::size_t count)
+	{
+		std::advance(pos.first, count);
+		std::advance(pos.second, count);
+		return pos;
+	}
+};
+
+// Leaf function which passes whole chunks to a chunk-level function, as raw
+// pointers if both the input and output are contiguous.
+template<typename OutIter, typename Func>
+struct chunked_transform_leaf {
+	typedef OutIter cursor;
+	const Func& func;
+
+	template<typename InIter>
+	void operator()(InIter begin, InIter end, OutIter out) const
+	{
+		typedef std::integral_constant<bool, is_contiguous_iterator<InIter>::value && is_contiguous_iterator<OutIter>::value> contiguous;
+		if (begin != end)
+			call(begin, end, out, contiguous());
+	}
+	template<typename InIter>
+	void call(InIter begin, InIter end, OutIter out, std::false_type) const
+	{
+		func(begin, end, out);
+	}
+	template<typename InIter>
+	void call(InIter begin, InIter end, OutIter out, std::true_type) const
+	{
+		auto in_ptr = detail::to_pointer(begin);
+		func(in_ptr, in_ptr + (end - begin), detail::to_pointer(out));
+	}
+	static OutIter advance(OutIter out, std::size_t count)
+	{
+		std::advance(out, count);
+		return out;
+	}
+};
+
+// Internal implementation of parallel_transform that only accepts a
+// partitioner argument. The cursor of the second half of a split is found by
+// advancing the cursor of the first half by its length, which is constant
+// time for random-access iterators. Other iterators are walked once per
+// level of splitting, rather than from the start of the range for each leaf.
+template<typename Sched, typename Partitioner, typename Leaf>
+void internal_parallel_transform(Sched& sched, Partitioner partitioner, typename Leaf::cursor pos, const Leaf& leaf)
+{
+	// Split the partition, processing deferred partitions inline (see
+	// internal_parallel_for).
+	auto subpart = partitioner.split();
+	while (detail::partition_deferred(subpart, 0)) {
+		leaf(partitioner.begin(), partitioner.end(), pos);
+		pos = Leaf::advance(pos, std::distance(partitioner.begin(), partitioner.end()));
+		partitioner = std::move(subpart);
+		subpart = partitioner.split();
+	}
+
+	// Run inline if no more splits are possible
+	if (subpart.begin() == subpart.end()) {
+		leaf(partitioner.begin(), partitioner.end(), pos);
+		return;
+	}
+
+	// Run the function over each half in parallel
+	typename Leaf::cursor subpart_pos = Leaf::advance(pos, std::distance(partitioner.begin(), partitioner.end()));
+	auto&& subpart_sched = detail::partition_scheduler(sched, subpart);
+	auto&& t = async::local_spawn(subpart_sched, [&sched, &subpart, &subpart_pos, &leaf] {
+		detail::internal_parallel_transform(sched, std::move(subpart), subpart_pos, leaf);
+	});
+	detail::internal_parallel_transform(sched, std::move(partitioner), pos, leaf);
+	t.get();
+}
+
+// Output iterators are written from several threads at once, so they must
+// refer to actual elements, which excludes insert and stream iterators.
+template<typename Iter>
+struct is_forward_iterator: public std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iter>::iterator_category> {};
+
+} // namespace detail
+
+// Apply a function to each element in a range and write the results to an
+// output range. Returns an iterator to the end of the output range.
+template<typename Sched, typename Range, typename OutIter, typename Func>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_transform(Sched& sched, Range&& range, OutIter out, const Func& func)
+{
+	static_assert(detail::is_forward_iterator<OutIter>::value, "parallel_transform requires a forward output iterator");
+
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	std::size_t length = std::distance(partitioner.begin(), partitioner.end());
+	detail::internal_parallel_transform(sched, std::move(partitioner), out, detail::unary_transform_leaf<OutIter, Func>{func});
+	std::advance(out, length);
+	return out;
+}
+
+// Apply a binary function to each pair of elements from a range and a second
+// input sequence of at least the same length, and write the results to an
+// output range. Returns an iterator to the end of the output range.
+template<typename Sched, typename Range, typename InIter2, typename OutIter, typename Func>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_transform(Sched& sched, Range&& range, InIter2 in2, OutIter out, const Func& func)
+{
+	static_assert(detail::is_forward_iterator<InIter2>::value, "parallel_transform requires a forward iterator for the second input");
+	static_assert(detail::is_forward_iterator<OutIter>::value, "parallel_transform requires a forward output iterator");
+
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	std::size_t length = std::distance(partitioner.begin(), partitioner.end());
+	detail::internal_parallel_transform(sched, std::move(partitioner), std::make_pair(in2, out), detail::binary_transform_leaf<InIter2, OutIter, Func>{func});
+	std::advance(out, length);
+	return out;
+}
+
+// Overloads with default scheduler
+template<typename Range, typename OutIter, typename Func>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, OutIter>::type parallel_transform(Range&& range, OutIter out, const Func& func)
+{
+	return async::parallel_transform(::async::default_scheduler(), std::forward<Range>(range), out, func);
+}
+template<typename Range, typename InIter2, typename OutIter, typename Func>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, OutIter>::type parallel_transform(Range&& range, InIter2 in2, OutIter out, const Func& func)
+{
+	return async::parallel_transform(::async::default_scheduler(), std::forward<Range>(range), in2, out, func);
+}
+
+// Apply a chunk-level function to a range, writing to an output range. The
+// function is called as func(begin, end, out) for each non-empty chunk of the
+// input, where out is the position of the chunk in the output, and must write
+// one output element for each input element. If the input and output are
+// both contiguous then raw pointers are passed, so the function can use a
+// vectorized loop. Returns an iterator to the end of the output range.
+template<typename Sched, typename Range, typename OutIter, typename Func>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_transform_chunked(Sched& sched, Range&& range, OutIter out, const Func& func)
+{
+	static_assert(detail::is_forward_iterator<OutIter>::value, "parallel_transform_chunked requires a forward output iterator");
+
+	auto partitioner = async::to_partitioner(std::forward<Range>(range));
+	std::size_t length = std::distance(partitioner.begin(), partitioner.end());
+	detail::internal_parallel_transform(sched, std::move(partitioner), out, detail::chunked_transform_leaf<OutIter, Func>{func});
+	std::advance(out, length);
+	return out;
+}
+
+// Overload with default scheduler
+template<typename Range, typename OutIter, typename Func>
+typename std::enable_if<!detail::is_scheduler<typename std::decay<Range>::type>::value, OutIter>::type parallel_transform_chunked(Range&& range, OutIter out, const Func& func)
+{
+	return async::parallel_transform_chunked(::async::default_scheduler(), std::forward<Range>(range), out, func);
+}
+
+// Overloads with std::initializer_list
+template<typename Sched, typename T, typename OutIter, typename Func>
+typename std::enable_if<detail::is_scheduler<Sched>::value, OutIter>::type parallel_transform(Sched& sched, std::initializer_list<T> range, OutIter out, const Func& func)
+{
+	return async::parallel_transform(sched, async::make_range(range.begin(), range.end()), out, func);
+}
+template<typename T, typename OutIter, typename Func>
+OutIter parallel_transform(std::initializer_list<T> range, OutIter out, const Func& func)
+{
+	return async::parallel_transform(async::make_range(range.begin(), range.end()), out, func);
+}
+
+} // namespace async
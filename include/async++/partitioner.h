@@ -39,6 +39,36 @@ one& is_partitioner_helper(...);
 template<typename T>
 struct is_partitioner: public std::integral_constant<bool, sizeof(is_partitioner_helper<T>(0)) - 1> {};
 
+// Chunk-level algorithms need to check whether a partition is empty and what
+// to pass to the user function for a leaf. For iterator-based partitioners a
+// leaf is passed as an async::range. Other partitioner types, such as
+// blocked_range2d, provide their own overloads.
+template<typename Partitioner>
+bool partition_empty(const Partitioner& p)
+{
+	return p.begin() == p.end();
+}
+template<typename Partitioner>
+range<decltype(std::declval<Partitioner>().begin())> partition_chunk(const Partitioner& p)
+{
+	return {p.begin(), p.end()};
+}
+
+// Partitioners can mark the partition returned by split() as deferred, which
+// means that it is not worth running in a separate task. Instead, the
+// algorithm processes the current partition and then continues with the
+// deferred one in the same thread.
+template<typename Partitioner>
+auto partition_deferred(const Partitioner& p, int) -> decltype(p.deferred())
+{
+	return p.deferred();
+}
+template<typename Partitioner>
+bool partition_deferred(const Partitioner&, ...)
+{
+	return false;
+}
+
 // Automatically determine a grain size for a sequence length
 inline std::size_t auto_grain_size(std::size_t dist)
 {
@@ -51,14 +81,80 @@ inline std::size_t auto_grain_size(std::size_t dist)
 	return grain;
 }
 
+// Determine a grain size which only depends on the sequence length, for use by
+// deterministic_partitioner.
+inline std::size_t deterministic_grain_size(std::size_t dist)
+{
+	std::size_t grain = dist / 256;
+	if (grain < 1)
+		grain = 1;
+	if (grain > 2048)
+		grain = 2048;
+	return grain;
+}
+
+// Collect the boundaries of the chunks of grain elements in a range, in a
+// single pass over the range. This is used by partitioners for ranges without
+// random-access iterators, so that they can split the range in constant time
+// instead of walking half of the range on each split. The result contains one
+// iterator per chunk followed by the end of the range.
 template<typename Iter>
+std::shared_ptr<const std::vector<Iter>> collect_chunk_boundaries(Iter begin, Iter end, std::size_t length, std::size_t grain)
+{
+	std::shared_ptr<std::vector<Iter>> bounds = std::make_shared<std::vector<Iter>>();
+	bounds->reserve((length + grain - 1) / grain + 1);
+	bounds->push_back(begin);
+	while (begin != end) {
+		for (std::size_t i = 0; i < grain && begin != end; i++)
+			++begin;
+		bounds->push_back(begin);
+	}
+	return bounds;
+}
+
+// Partitioners are specialized on the iterator category. Random-access ranges
+// are split in half using the cached length of the range, while other ranges
+// are split on the chunk boundaries collected by collect_chunk_boundaries.
+template<typename Iter, typename Category = typename std::iterator_traits<Iter>::iterator_category>
 class static_partitioner_impl {
+	std::shared_ptr<const std::vector<Iter>> bounds;
+	std::size_t first_chunk, last_chunk;
+
+public:
+	static_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_)
+		: bounds(detail::collect_chunk_boundaries(begin_, end_, length_, grain_)), first_chunk(0), last_chunk(bounds->size() - 1) {}
+	Iter begin() const
+	{
+		return (*bounds)[first_chunk];
+	}
+	Iter end() const
+	{
+		return (*bounds)[last_chunk];
+	}
+	static_partitioner_impl split()
+	{
+		// Don't split if we only have a single chunk left
+		std::size_t num_chunks = last_chunk - first_chunk;
+		static_partitioner_impl out = *this;
+		out.first_chunk = last_chunk;
+		if (num_chunks <= 1)
+			return out;
+
+		// Split our range in half, on a chunk boundary
+		last_chunk = first_chunk + (num_chunks + 1) / 2;
+		out.first_chunk = last_chunk;
+		return out;
+	}
+};
+template<typename Iter>
+class static_partitioner_impl<Iter, std::random_access_iterator_tag> {
 	Iter iter_begin, iter_end;
+	std::size_t length;
 	std::size_t grain;
 
 public:
-	static_partitioner_impl(Iter begin_, Iter end_, std::size_t grain_)
-		: iter_begin(begin_), iter_end(end_), grain(grain_) {}
+	static_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_)
+		: iter_begin(begin_), iter_end(end_), length(length_), grain(grain_) {}
 	Iter begin() const
 	{
 		return iter_begin;
@@ -70,30 +166,79 @@ public:
 	static_partitioner_impl split()
 	{
 		// Don't split if below grain size
-		std::size_t length = std::distance(iter_begin, iter_end);
-		static_partitioner_impl out(iter_end, iter_end, grain);
+		static_partitioner_impl out(iter_end, iter_end, 0, grain);
 		if (length <= grain)
 			return out;
 
 		// Split our range in half
-		iter_end = iter_begin;
-		std::advance(iter_end, (length + 1) / 2);
+		std::size_t split_length = (length + 1) / 2;
+		iter_end = iter_begin + split_length;
 		out.iter_begin = iter_end;
+		out.length = length - split_length;
+		length = split_length;
 		return out;
 	}
 };
 
-template<typename Iter>
+template<typename Iter, typename Category = typename std::iterator_traits<Iter>::iterator_category>
 class auto_partitioner_impl {
+	std::shared_ptr<const std::vector<Iter>> bounds;
+	std::size_t first_chunk, last_chunk;
+	std::size_t num_threads;
+	std::thread::id last_thread;
+
+public:
+	// thread_id is initialized to "no thread" and will be set on first split
+	auto_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_)
+		: bounds(detail::collect_chunk_boundaries(begin_, end_, length_, grain_)), first_chunk(0), last_chunk(bounds->size() - 1) {}
+	Iter begin() const
+	{
+		return (*bounds)[first_chunk];
+	}
+	Iter end() const
+	{
+		return (*bounds)[last_chunk];
+	}
+	auto_partitioner_impl split()
+	{
+		// Don't split if we only have a single chunk left
+		std::size_t num_chunks = last_chunk - first_chunk;
+		auto_partitioner_impl out = *this;
+		out.first_chunk = last_chunk;
+		if (num_chunks <= 1)
+			return out;
+
+		// Check if we are in a different thread than we were before
+		std::thread::id current_thread = std::this_thread::get_id();
+		if (current_thread != last_thread)
+			num_threads = hardware_concurrency();
+
+		// If we only have one thread, don't split
+		if (num_threads <= 1)
+			return out;
+
+		// Split our range in half, on a chunk boundary
+		last_chunk = first_chunk + (num_chunks + 1) / 2;
+		out.first_chunk = last_chunk;
+		out.last_thread = current_thread;
+		last_thread = current_thread;
+		out.num_threads = num_threads / 2;
+		num_threads -= out.num_threads;
+		return out;
+	}
+};
+template<typename Iter>
+class auto_partitioner_impl<Iter, std::random_access_iterator_tag> {
 	Iter iter_begin, iter_end;
+	std::size_t length;
 	std::size_t grain;
 	std::size_t num_threads;
 	std::thread::id last_thread;
 
 public:
 	// thread_id is initialized to "no thread" and will be set on first split
-	auto_partitioner_impl(Iter begin_, Iter end_, std::size_t grain_)
-		: iter_begin(begin_), iter_end(end_), grain(grain_) {}
+	auto_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_)
+		: iter_begin(begin_), iter_end(end_), length(length_), grain(grain_) {}
 	Iter begin() const
 	{
 		return iter_begin;
@@ -105,8 +250,7 @@ public:
 	auto_partitioner_impl split()
 	{
 		// Don't split if below grain size
-		std::size_t length = std::distance(iter_begin, iter_end);
-		auto_partitioner_impl out(iter_end, iter_end, grain);
+		auto_partitioner_impl out(iter_end, iter_end, 0, grain);
 		if (length <= grain)
 			return out;
 
@@ -120,9 +264,11 @@ public:
 			return out;
 
 		// Split our range in half
-		iter_end = iter_begin;
-		std::advance(iter_end, (length + 1) / 2);
+		std::size_t split_length = (length + 1) / 2;
+		iter_end = iter_begin + split_length;
 		out.iter_begin = iter_end;
+		out.length = length - split_length;
+		length = split_length;
 		out.last_thread = current_thread;
 		last_thread = current_thread;
 		out.num_threads = num_threads / 2;
@@ -131,6 +277,248 @@ public:
 	}
 };
 
+// Partitioner which uses lazy binary splitting: the range is only split in
+// half when other threads in the pool are idle and the current thread has no
+// queued tasks they could steal. Otherwise a chunk of grain elements is split
+// off and processed inline, and the rest of the range is deferred. This keeps
+// the overhead close to a sequential loop when there is no stealing.
+//
+// Threads outside a thread pool can't tell whether the pool is idle, so they
+// instead split the range into one part per hardware thread.
+template<typename Iter>
+class lazy_partitioner_impl {
+	Iter iter_begin, iter_end;
+	std::size_t length;
+	std::size_t grain;
+	std::size_t num_threads;
+	bool is_deferred;
+
+public:
+	lazy_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_)
+		: iter_begin(begin_), iter_end(end_), length(length_), grain(grain_), num_threads(hardware_concurrency()), is_deferred(false) {}
+	Iter begin() const
+	{
+		return iter_begin;
+	}
+	Iter end() const
+	{
+		return iter_end;
+	}
+	bool deferred() const
+	{
+		return is_deferred;
+	}
+	lazy_partitioner_impl split()
+	{
+		// Don't split if below grain size
+		lazy_partitioner_impl out(iter_end, iter_end, 0, grain);
+		if (length <= grain)
+			return out;
+
+		// Decide whether to split in half or to split off one chunk
+		bool split_half;
+		if (detail::current_thread_index() == invalid_thread_index)
+			split_half = num_threads > 1;
+		else
+			split_half = detail::pool_is_hungry();
+		std::size_t split_length;
+		if (split_half) {
+			split_length = (length + 1) / 2;
+			out.num_threads = num_threads / 2;
+			num_threads -= out.num_threads;
+		} else {
+			split_length = grain;
+			out.num_threads = num_threads;
+			out.is_deferred = true;
+		}
+
+		iter_end = iter_begin;
+		std::advance(iter_end, split_length);
+		out.iter_begin = iter_end;
+		out.length = length - split_length;
+		length = split_length;
+		return out;
+	}
+};
+
+// Partitioner which splits lazily like lazy_partitioner_impl, but measures how
+// long each chunk takes to process and adjusts the grain size so that a chunk
+// takes roughly the target duration. Chunks are timed from the point where
+// they are split off until the next call to split(), which is when the
+// algorithm moves on to the deferred rest of the range. The learned grain size
+// is stored back into the adaptive_partitioner that created this partitioner.
+template<typename Iter>
+class adaptive_partitioner_impl {
+	typedef std::chrono::steady_clock clock;
+
+	Iter iter_begin, iter_end;
+	std::size_t length;
+	std::size_t grain;
+	std::size_t num_threads;
+	std::atomic<std::size_t>* learned_grain;
+	clock::duration target;
+	clock::time_point chunk_start;
+	bool is_deferred;
+
+	// Largest grain size we will pick, which is already far more than can be
+	// processed in any reasonable target duration.
+	static const std::size_t max_grain = std::size_t(1) << 24;
+
+	void update_grain()
+	{
+		// Scale the grain size by at most a factor of 8 per chunk to limit the
+		// effect of noisy measurements.
+		double elapsed = static_cast<double>((clock::now() - chunk_start).count());
+		double scale = elapsed > 0 ? static_cast<double>(target.count()) / elapsed : 8;
+		if (scale > 8)
+			scale = 8;
+		else if (scale < 0.125)
+			scale = 0.125;
+		double new_grain = static_cast<double>(grain) * scale;
+		if (new_grain < 1)
+			grain = 1;
+		else if (new_grain > max_grain)
+			grain = max_grain;
+		else
+			grain = static_cast<std::size_t>(new_grain);
+		learned_grain->store(grain, std::memory_order_relaxed);
+	}
+
+public:
+	adaptive_partitioner_impl(Iter begin_, Iter end_, std::size_t length_, std::size_t grain_, std::atomic<std::size_t>* learned_grain_, clock::duration target_)
+		: iter_begin(begin_), iter_end(end_), length(length_), grain(grain_), num_threads(hardware_concurrency()), learned_grain(learned_grain_), target(target_), is_deferred(false) {}
+	Iter begin() const
+	{
+		return iter_begin;
+	}
+	Iter end() const
+	{
+		return iter_end;
+	}
+	bool deferred() const
+	{
+		return is_deferred;
+	}
+	adaptive_partitioner_impl split()
+	{
+		// If we were deferred then the previous chunk has just been processed
+		if (is_deferred) {
+			update_grain();
+			is_deferred = false;
+		}
+
+		// Don't split if below grain size
+		adaptive_partitioner_impl out(iter_end, iter_end, 0, grain, learned_grain, target);
+		if (length <= grain)
+			return out;
+
+		// Decide whether to split in half or to split off one chunk, in the
+		// same way as lazy_partitioner_impl.
+		bool split_half;
+		if (detail::current_thread_index() == invalid_thread_index)
+			split_half = num_threads > 1;
+		else
+			split_half = detail::pool_is_hungry();
+		std::size_t split_length;
+		if (split_half) {
+			split_length = (length + 1) / 2;
+			out.num_threads = num_threads / 2;
+			num_threads -= out.num_threads;
+		} else {
+			split_length = grain;
+			out.num_threads = num_threads;
+			out.is_deferred = true;
+			out.chunk_start = clock::now();
+		}
+
+		iter_end = iter_begin;
+		std::advance(iter_end, split_length);
+		out.iter_begin = iter_end;
+		out.length = length - split_length;
+		length = split_length;
+		return out;
+	}
+};
+
+// Partitioner which splits a range into fixed chunks of grain elements and
+// records which thread executed each chunk in an array owned by an
+// affinity_partitioner.
+template<typename Iter>
+class affinity_partitioner_impl {
+	Iter iter_begin, iter_end;
+	std::size_t first_chunk, num_chunks;
+	std::size_t grain;
+	std::size_t* chunk_threads;
+
+public:
+	affinity_partitioner_impl(Iter begin_, Iter end_, std::size_t first_chunk_, std::size_t num_chunks_, std::size_t grain_, std::size_t* chunk_threads_)
+		: iter_begin(begin_), iter_end(end_), first_chunk(first_chunk_), num_chunks(num_chunks_), grain(grain_), chunk_threads(chunk_threads_) {}
+	Iter begin() const
+	{
+		return iter_begin;
+	}
+	Iter end() const
+	{
+		return iter_end;
+	}
+	affinity_partitioner_impl split()
+	{
+		// If we are down to a single chunk then this partition is about to be
+		// executed, so record the thread that is executing it.
+		affinity_partitioner_impl out(iter_end, iter_end, first_chunk + num_chunks, 0, grain, chunk_threads);
+		if (num_chunks <= 1) {
+			if (num_chunks == 1)
+				chunk_threads[first_chunk] = detail::current_thread_index();
+			return out;
+		}
+
+		// Split our range in half, on a chunk boundary
+		std::size_t left_chunks = (num_chunks + 1) / 2;
+		iter_end = iter_begin;
+		std::advance(iter_end, left_chunks * grain);
+		out.iter_begin = iter_end;
+		out.first_chunk = first_chunk + left_chunks;
+		out.num_chunks = num_chunks - left_chunks;
+		num_chunks = left_chunks;
+		return out;
+	}
+
+	// Thread which executed the first chunk of this partition the last time
+	std::size_t preferred_thread() const
+	{
+		return num_chunks == 0 ? invalid_thread_index : chunk_threads[first_chunk];
+	}
+};
+
+// Scheduler wrapper which tries to run tasks on a specific thread
+template<typename Sched>
+struct affinity_scheduler {
+	Sched& sched;
+	std::size_t thread;
+
+	void schedule(task_run_handle t)
+	{
+		if (thread == invalid_thread_index)
+			sched.schedule(std::move(t));
+		else
+			detail::schedule_on_thread(sched, thread, std::move(t), 0);
+	}
+};
+
+// Get the scheduler used to spawn the task for a partition produced by
+// split(). Partitions from an affinity_partitioner are sent to the thread
+// which executed them previously, other partitions use the original scheduler.
+template<typename Sched, typename Partitioner>
+Sched& partition_scheduler(Sched& sched, const Partitioner&)
+{
+	return sched;
+}
+template<typename Sched, typename Iter>
+affinity_scheduler<Sched> partition_scheduler(Sched& sched, const affinity_partitioner_impl<Iter>& p)
+{
+	return {sched, p.preferred_thread()};
+}
+
 } // namespace detail
 
 // A simple partitioner which splits until a grain size is reached. If a grain
@@ -138,13 +526,33 @@ public:
 template<typename Range>
 detail::static_partitioner_impl<decltype(std::begin(std::declval<Range>()))> static_partitioner(Range&& range, std::size_t grain)
 {
-	return {std::begin(range), std::end(range), grain};
+	std::size_t length = std::distance(std::begin(range), std::end(range));
+	return {std::begin(range), std::end(range), length, grain < 1 ? 1 : grain};
 }
 template<typename Range>
 detail::static_partitioner_impl<decltype(std::begin(std::declval<Range>()))> static_partitioner(Range&& range)
 {
-	std::size_t grain = detail::auto_grain_size(std::distance(std::begin(range), std::end(range)));
-	return {std::begin(range), std::end(range), grain};
+	std::size_t length = std::distance(std::begin(range), std::end(range));
+	return {std::begin(range), std::end(range), length, detail::auto_grain_size(length)};
+}
+
+// A partitioner whose splits only depend on the length of the range and the
+// grain size, and not on the number of threads or on which threads end up
+// running each part. If a grain size is not specified, one is chosen based on
+// the length of the range only. Since parallel_reduce and parallel_map_reduce
+// always combine partial results in index order, using this partitioner makes
+// their result reproducible across runs and machines, even with non-associative
+// operations such as floating-point addition.
+template<typename Range>
+detail::static_partitioner_impl<decltype(std::begin(std::declval<Range>()))> deterministic_partitioner(Range&& range, std::size_t grain)
+{
+	return async::static_partitioner(std::forward<Range>(range), grain);
+}
+template<typename Range>
+detail::static_partitioner_impl<decltype(std::begin(std::declval<Range>()))> deterministic_partitioner(Range&& range)
+{
+	std::size_t length = std::distance(std::begin(range), std::end(range));
+	return {std::begin(range), std::end(range), length, detail::deterministic_grain_size(length)};
 }
 
 // A more advanced partitioner which initially divides the range into one chunk
@@ -153,10 +561,105 @@ detail::static_partitioner_impl<decltype(std::begin(std::declval<Range>()))> sta
 template<typename Range>
 detail::auto_partitioner_impl<decltype(std::begin(std::declval<Range>()))> auto_partitioner(Range&& range)
 {
-	std::size_t grain = detail::auto_grain_size(std::distance(std::begin(range), std::end(range)));
-	return {std::begin(range), std::end(range), grain};
+	std::size_t length = std::distance(std::begin(range), std::end(range));
+	return {std::begin(range), std::end(range), length, detail::auto_grain_size(length)};
 }
 
+// A partitioner which only splits the range when other threads are idle. The
+// grain size is the size of the chunks processed between checks for idle
+// threads, and is chosen automatically if not specified.
+template<typename Range>
+detail::lazy_partitioner_impl<decltype(std::begin(std::declval<Range>()))> lazy_partitioner(Range&& range, std::size_t grain)
+{
+	return {std::begin(range), std::end(range), static_cast<std::size_t>(std::distance(std::begin(range), std::end(range))), grain < 1 ? 1 : grain};
+}
+template<typename Range>
+detail::lazy_partitioner_impl<decltype(std::begin(std::declval<Range>()))> lazy_partitioner(Range&& range)
+{
+	std::size_t length = std::distance(std::begin(range), std::end(range));
+	return {std::begin(range), std::end(range), length, detail::auto_grain_size(length)};
+}
+
+// A partitioner which remembers which thread executed each chunk of a range
+// and tries to run the same chunk on the same thread the next time it is used.
+// This improves cache reuse when a loop is run repeatedly over the same data.
+// The range is split into fixed chunks of grain elements, and tasks are sent
+// to their previous thread using the scheduler's schedule_on() function if it
+// has one. Other threads can still steal them if they run out of work.
+//
+// An affinity_partitioner object should be kept alive across the calls to
+// the parallel algorithm and used like this:
+// async::parallel_for(sched, ap(range), func);
+// It must not be used by multiple parallel algorithms at the same time.
+class affinity_partitioner {
+	std::vector<std::size_t> chunk_threads;
+	std::size_t length;
+	std::size_t grain;
+
+public:
+	affinity_partitioner()
+		: length(0), grain(0) {}
+
+	template<typename Range>
+	detail::affinity_partitioner_impl<decltype(std::begin(std::declval<Range>()))> operator()(Range&& range, std::size_t grain_)
+	{
+		// Forget the previous thread assignments if the shape of the range
+		// has changed.
+		std::size_t new_length = std::distance(std::begin(range), std::end(range));
+		if (grain_ < 1)
+			grain_ = 1;
+		if (new_length != length || grain_ != grain) {
+			length = new_length;
+			grain = grain_;
+			chunk_threads.assign((length + grain - 1) / grain, detail::invalid_thread_index);
+		}
+		return {std::begin(range), std::end(range), 0, chunk_threads.size(), grain, chunk_threads.data()};
+	}
+	template<typename Range>
+	detail::affinity_partitioner_impl<decltype(std::begin(std::declval<Range>()))> operator()(Range&& range)
+	{
+		std::size_t grain_ = detail::auto_grain_size(std::distance(std::begin(range), std::end(range)));
+		return (*this)(std::forward<Range>(range), grain_);
+	}
+};
+
+// A partitioner which picks its grain size by timing chunks as they are
+// processed, aiming for each chunk to take around the target duration (30us by
+// default). The grain size learned during one call is kept in this object and
+// used as the starting point of the next one, so an adaptive_partitioner
+// should be kept alive across calls from the same call site:
+//
+// static async::adaptive_partitioner ap;
+// async::parallel_for(ap(range), func);
+class adaptive_partitioner {
+	std::atomic<std::size_t> grain;
+	std::chrono::steady_clock::duration target;
+
+public:
+	explicit adaptive_partitioner(std::chrono::steady_clock::duration target_ = std::chrono::microseconds(30))
+		: grain(1), target(target_) {}
+
+	template<typename Range>
+	detail::adaptive_partitioner_impl<decltype(std::begin(std::declval<Range>()))> operator()(Range&& range)
+	{
+		std::size_t length = std::distance(std::begin(range), std::end(range));
+		return {std::begin(range), std::end(range), length, grain.load(std::memory_order_relaxed), &grain, target};
+	}
+
+	// Current grain size estimate
+	std::size_t grain_size() const
+	{
+		return grain.load(std::memory_order_relaxed);
+	}
+
+	// Forget the learned grain size, for example if the cost of the loop body
+	// has changed.
+	void reset()
+	{
+		grain.store(1, std::memory_order_relaxed);
+	}
+};
+
 // Wrap a range in a partitioner. If the input is already a partitioner then it
 // is returned unchanged. This allows parallel algorithms to accept both ranges
 // and partitioners as parameters.
@@ -179,4 +179,25 @@ int_range<typename std::common_type<T, U>::type> irange(T begin, U end)
 	return {begin, end};
 }
 
+namespace detail {
+
+// Detect iterators which refer to contiguous memory: raw pointers and
+// std::vector iterators (except for std::vector<bool>). Algorithms can use
+// this to work on raw pointers, which is much easier to vectorize.
+template<typename Iter>
+struct is_contiguous_iterator: public std::integral_constant<bool, std::is_pointer<Iter>::value ||
+	(!std::is_same<typename std::iterator_traits<Iter>::value_type, bool>::value &&
+	 (std::is_same<Iter, typename std::vector<typename std::iterator_traits<Iter>::value_type>::iterator>::value ||
+	  std::is_same<Iter, typename std::vector<typename std::iterator_traits<Iter>::value_type>::const_iterator>::value))> {};
+
+// Get a raw pointer from a contiguous iterator. The iterator must be
+// dereferenceable.
+template<typename Iter>
+typename std::remove_reference<typename std::iterator_traits<Iter>::reference>::type* to_pointer(Iter it)
+{
+	return std::addressof(*it);
+}
+
+} // namespace detail
+
 } // namespace async
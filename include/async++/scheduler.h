@@ -130,7 +130,20 @@ public:
 	// Run the task and release the handle
 	void run()
 	{
-		handle->vtable->run(handle.get());
+#ifdef LIBASYNC_TASK_TIMING
+		std::uint64_t schedule_time = handle->schedule_time;
+		std::uint64_t start_time = detail::timing_now();
+#endif
+		detail::task_base* t = handle.get();
+		LIBASYNC_PROBE2(task_run_begin, t, t->tag);
+		if (task_observer* observer = detail::get_task_observer())
+			detail::run_observed_task(observer, t);
+		else
+			t->vtable->run(t);
+		LIBASYNC_PROBE2(task_run_end, t, t->tag);
+#ifdef LIBASYNC_TASK_TIMING
+		detail::record_task_timing(schedule_time, start_time, detail::timing_now());
+#endif
 		handle = nullptr;
 	}
 
@@ -162,6 +175,12 @@ template<typename Sched>
 void schedule_task(Sched& sched, task_ptr t)
 {
 	static_assert(is_scheduler<Sched>::value, "Type is not a valid scheduler");
+#ifdef LIBASYNC_TASK_TIMING
+	t->schedule_time = timing_now();
+#endif
+	LIBASYNC_PROBE2(task_schedule, t.get(), t->tag);
+	if (task_observer* observer = get_task_observer())
+		observer->on_schedule(t.get(), t->tag);
 	sched.schedule(task_run_handle(std::move(t)));
 }
 
@@ -171,5 +190,70 @@ inline void inline_scheduler_impl::schedule(task_run_handle t)
 	t.run();
 }
 
+// Schedule a task on a specific thread, for schedulers which support it.
+// Other schedulers just schedule the task normally.
+template<typename Sched>
+auto schedule_on_thread(Sched& sched, std::size_t thread, task_run_handle t, int) -> decltype(sched.schedule_on(thread, std::move(t)))
+{
+	return sched.schedule_on(thread, std::move(t));
+}
+template<typename Sched>
+void schedule_on_thread(Sched& sched, std::size_t, task_run_handle t, ...)
+{
+	sched.schedule(std::move(t));
+}
+
 } // namespace detail
+
+// Reusable barrier for a fixed number of threads, such as the threads of a
+// run_on_all_workers() region. This is a centralized sense-reversing barrier
+// where the sense is a generation counter, so threads don't need to keep a
+// local copy of it. The last thread to arrive resets the count for the next
+// phase and releases the others.
+//
+// Waiting threads spin for a short while and then yield, they don't run other
+// tasks. All threads using the barrier must be running at the same time,
+// otherwise it will deadlock.
+class pool_barrier {
+	std::size_t num_threads;
+	LIBASYNC_CACHELINE_ALIGN std::atomic<std::size_t> remaining;
+	LIBASYNC_CACHELINE_ALIGN std::atomic<std::size_t> generation;
+
+public:
+	explicit pool_barrier(std::size_t count)
+		: num_threads(count), remaining(count), generation(0) {}
+
+	pool_barrier(const pool_barrier&) = delete;
+	pool_barrier& operator=(const pool_barrier&) = delete;
+
+	// Wait until all threads have reached the barrier
+	void wait()
+	{
+		std::size_t current = generation.load(std::memory_order_acquire);
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			remaining.store(num_threads, std::memory_order_relaxed);
+			generation.store(current + 1, std::memory_order_release);
+			return;
+		}
+
+		for (unsigned spins = 0; generation.load(std::memory_order_acquire) == current; spins++) {
+			if (spins < 1024)
+				continue;
+#if defined(__GLIBCXX__) && __GLIBCXX__ <= 20140612
+			// Some versions of libstdc++ (4.7 and below) don't include a
+			// definition of std::this_thread::yield().
+			sched_yield();
+#else
+			std::this_thread::yield();
+#endif
+		}
+	}
+
+	// Get the number of threads the barrier waits for
+	std::size_t size() const
+	{
+		return num_threads;
+	}
+};
+
 } // namespace async
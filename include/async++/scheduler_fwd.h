@@ -68,6 +68,35 @@ LIBASYNC_EXPORT void wait_for_task(task_base* wait_task);
 // Forward-declaration for data used by threadpool_scheduler
 struct threadpool_data;
 
+// Thread index value used for threads which are not part of a thread pool
+const std::size_t invalid_thread_index = static_cast<std::size_t>(-1);
+
+// Get the index of the current thread in the thread pool it belongs to, or
+// invalid_thread_index if it is not a thread pool worker.
+LIBASYNC_EXPORT std::size_t current_thread_index() LIBASYNC_NOEXCEPT;
+
+// Get the thread pool the current thread belongs to, or null if it is not a
+// thread pool worker, and the number of threads in a thread pool.
+LIBASYNC_EXPORT threadpool_data* current_threadpool() LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT std::size_t threadpool_num_threads(const threadpool_data* pool) LIBASYNC_NOEXCEPT;
+
+// Check whether the thread pool of the current thread has idle workers which
+// could run tasks spawned by this thread. This is only a hint, and is always
+// false if the current thread is not a thread pool worker.
+LIBASYNC_EXPORT bool pool_is_hungry() LIBASYNC_NOEXCEPT;
+
+#ifdef LIBASYNC_TASK_TIMING
+// Get a timestamp in nanoseconds for task timing
+inline std::uint64_t timing_now()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Record the timestamps of a task which has just finished running. This is
+// only recorded if the current thread is a thread pool worker.
+LIBASYNC_EXPORT void record_task_timing(std::uint64_t schedule_time, std::uint64_t start_time, std::uint64_t end_time) LIBASYNC_NOEXCEPT;
+#endif
+
 } // namespace detail
 
 // Run a task in the current thread as soon as it is scheduled
@@ -123,6 +152,45 @@ public:
 	LIBASYNC_EXPORT void run_all_tasks();
 };
 
+// Histogram of durations with power of 2 buckets: bucket i counts durations
+// of 2^i to 2^(i+1)-1 nanoseconds, and bucket 0 also counts zero durations.
+struct latency_histogram {
+	static const std::size_t num_buckets = 48;
+	std::uint64_t buckets[num_buckets];
+	std::uint64_t count;
+	std::uint64_t total_ns;
+
+	latency_histogram()
+		: buckets(), count(0), total_ns(0) {}
+
+	// Get an upper bound for the given percentile (between 0 and 100), with
+	// the precision of a bucket.
+	std::uint64_t percentile(double p) const
+	{
+		if (count == 0)
+			return 0;
+		std::uint64_t target = static_cast<std::uint64_t>(p / 100 * count);
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < num_buckets; i++) {
+			seen += buckets[i];
+			if (seen > target || seen == count)
+				return (std::uint64_t(2) << i) - 1;
+		}
+		return 0;
+	}
+};
+
+// Timing statistics of the tasks run by a thread pool. Queue delay is the time
+// between a task being scheduled and starting to run, run time covers the
+// execution of the task, including any other tasks run while it waits, and end
+// to end is the sum of both. These are only recorded if the library is built
+// with USE_TASK_TIMING, and are empty otherwise.
+struct task_timing_stats {
+	latency_histogram queue_delay;
+	latency_histogram run_time;
+	latency_histogram end_to_end;
+};
+
 // Scheduler that runs tasks in a work-stealing thread pool of the given size.
 // Note that destroying the thread pool before all tasks have completed may
 // result in some tasks not being executed.
@@ -146,8 +214,159 @@ public:
 
 	// Schedule a task to be run in the thread pool
 	LIBASYNC_EXPORT void schedule(task_run_handle t);
+
+	// Schedule a task to be run by a specific thread of the pool. The task is
+	// placed in that thread's mailbox, but other threads can still take it
+	// if they run out of work. An out of range index behaves like schedule().
+	LIBASYNC_EXPORT void schedule_on(std::size_t thread, task_run_handle t);
+
+	// Run a function exactly once on each thread of the pool, passing it the
+	// index of the thread, and wait for all calls to complete. The calls are
+	// delivered through per-thread mailboxes which other threads can't steal
+	// from, so they all run concurrently once every thread is free. This can
+	// be used with pool_barrier for bulk-synchronous parallel regions. If any
+	// call throws then the first exception is rethrown after all calls have
+	// completed.
+	//
+	// Every thread of the pool must eventually become free to run its call, so
+	// this must not be nested inside another run_on_all_workers() region of the
+	// same pool.
+	LIBASYNC_EXPORT void run_on_all_workers(const std::function<void(std::size_t)>& func);
+
+	// Get the number of threads in the pool
+	LIBASYNC_EXPORT std::size_t num_threads() const;
+
+	// Get the timing statistics of the tasks run by this pool, merged from
+	// the per-thread histograms, and reset them. Resetting while tasks are
+	// running may lose a few samples.
+	LIBASYNC_EXPORT task_timing_stats task_timing() const;
+	LIBASYNC_EXPORT void reset_task_timing();
+};
+
+// Information about the thread pool worker running the current code
+namespace this_worker {
+
+// Index value returned by index() for threads which are not pool workers
+const std::size_t invalid_index = detail::invalid_thread_index;
+
+// Get the index of the current thread in its thread pool, from 0 to
+// num_threads() - 1, or invalid_index if it isn't a pool worker. This can be
+// used to index preallocated per-worker state directly.
+LIBASYNC_EXPORT std::size_t index() LIBASYNC_NOEXCEPT;
+
+// Get the thread pool the current thread belongs to, or null if it isn't a
+// pool worker.
+LIBASYNC_EXPORT threadpool_scheduler* pool() LIBASYNC_NOEXCEPT;
+
+// Allocate temporary memory from the scratch arena of the current worker. The
+// alignment must be a power of 2. This is a simple pointer bump, and the whole
+// arena is reset when the top-level task running on the worker finishes, so
+// the memory must not be used after that and is never freed individually.
+// Tasks that a worker runs while waiting for another task are not top-level,
+// so their allocations remain until the outer task finishes.
+//
+// Returns null if the current thread isn't a pool worker, for example when
+// part of a parallel loop runs inline on the calling thread, in which case
+// the caller must fall back to normal allocation.
+LIBASYNC_EXPORT void* scratch_alloc(std::size_t size, std::size_t align);
+
+// Allocate uninitialized storage for an array from the scratch arena. Since
+// arena memory is released without running destructors, the type must be
+// trivially destructible.
+template<typename T>
+T* scratch_array(std::size_t count)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "scratch_array requires a trivially destructible type");
+	return static_cast<T*>(this_worker::scratch_alloc(count * sizeof(T), std::alignment_of<T>::value));
+}
+
+} // namespace this_worker
+
+// Opaque value attached to tasks to group them, such as the id of the request
+// being processed. 0 means no tag.
+typedef std::uintptr_t task_tag;
+
+// Interface for receiving task lifecycle events, for example to attribute CPU
+// samples of a profiler to logical tasks. Tasks are identified by the address
+// of their internal task object, which is only unique while the task exists.
+// Callbacks can be called concurrently from any thread and must not throw.
+class LIBASYNC_EXPORT_EXCEPTION task_observer {
+public:
+	virtual ~task_observer() {}
+
+	// Called when a task is handed to its scheduler
+	virtual void on_schedule(const void*, task_tag) {}
+
+	// Called on the thread running a task, before and after it runs
+	virtual void on_run_begin(const void*, task_tag) {}
+	virtual void on_run_end(const void*, task_tag) {}
+
+	// Called by a thread pool worker after it has taken a task from the queue
+	// or mailbox of another worker.
+	virtual void on_steal(std::size_t /*thief*/, std::size_t /*victim*/) {}
+
+	// Called by a thread pool worker when it goes to sleep because it has no
+	// work and when it wakes up again.
+	virtual void on_park(std::size_t /*thread*/) {}
+	virtual void on_unpark(std::size_t /*thread*/) {}
 };
 
+// Register an observer for the tasks of all schedulers, or unregister it by
+// passing null. The previously registered observer is returned. Callbacks may
+// still be running on other threads when this returns, so an observer must
+// not be destroyed until those threads are done with it, for example once
+// the thread pools are idle.
+//
+// While no observer is registered, each hook costs a single load and branch,
+// and tags are not tracked.
+LIBASYNC_EXPORT task_observer* set_task_observer(task_observer* observer) LIBASYNC_NOEXCEPT;
+
+// Get or set the tag of the current thread. Tasks created by a thread take its
+// current tag, and a thread running a task uses the tag of that task, so
+// tasks spawned from a task and continuations inherit the tag of their
+// parent. Tags are only captured while an observer is registered.
+LIBASYNC_EXPORT task_tag current_task_tag() LIBASYNC_NOEXCEPT;
+LIBASYNC_EXPORT task_tag set_current_task_tag(task_tag tag) LIBASYNC_NOEXCEPT;
+
+// Set the tag of the current thread for the lifetime of this object
+class task_tag_scope {
+	task_tag old_tag;
+
+public:
+	explicit task_tag_scope(task_tag tag)
+		: old_tag(async::set_current_task_tag(tag)) {}
+	~task_tag_scope()
+	{
+		async::set_current_task_tag(old_tag);
+	}
+
+	task_tag_scope(const task_tag_scope&) = delete;
+	task_tag_scope& operator=(const task_tag_scope&) = delete;
+};
+
+namespace detail {
+
+// Currently registered task observer, see set_task_observer()
+extern LIBASYNC_EXPORT std::atomic<task_observer*> registered_task_observer;
+
+// Get the registered observer, or null. This is the check done by every hook.
+inline task_observer* get_task_observer()
+{
+	return registered_task_observer.load(std::memory_order_acquire);
+}
+
+// Tag to give to a newly created task
+inline task_tag new_task_tag()
+{
+	return get_task_observer() ? async::current_task_tag() : 0;
+}
+
+// Run a task while an observer is registered: the task's tag becomes the
+// current tag of the thread, and the observer is notified.
+LIBASYNC_EXPORT void run_observed_task(task_observer* observer, task_base* t);
+
+} // namespace detail
+
 namespace detail {
 
 // Work-around for Intel compiler handling decltype poorly in function returns
@@ -74,6 +74,9 @@ class basic_task {
 		typename traits::task_type cont;
 		set_internal_task(cont, task_ptr(new task_func<Sched, exec_func, cont_internal_result>(std::forward<Func>(f), std::forward<Parent>(parent))));
 
+		// Continuations inherit the tag of their parent
+		get_internal_task(cont)->tag = my_internal->tag;
+
 		// Add the continuation to this task
 		// Avoid an expensive ref-count modification since the task isn't shared yet
 		get_internal_task(cont)->add_ref_unlocked();
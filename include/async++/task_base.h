@@ -73,6 +73,14 @@ struct LIBASYNC_CACHELINE_ALIGN task_base: public ref_count_base<task_base, task
 	// Virtual function table used for dynamic dispatch
 	const task_base_vtable* vtable;
 
+	// User tag captured when the task was created, see task_observer
+	task_tag tag;
+
+#ifdef LIBASYNC_TASK_TIMING
+	// Time at which the task was last scheduled, see timing_now()
+	std::uint64_t schedule_time;
+#endif
+
 	// Use aligned memory allocation
 	static void* operator new(std::size_t size)
 	{
@@ -85,7 +93,7 @@ struct LIBASYNC_CACHELINE_ALIGN task_base: public ref_count_base<task_base, task
 
 	// Initialize task state
 	task_base()
-		: state(task_state::pending) {}
+		: state(task_state::pending), tag(detail::new_task_tag()) {}
 
 	// Check whether the task is ready and include an acquire barrier if it is
 	bool ready() const
@@ -97,6 +105,7 @@ struct LIBASYNC_CACHELINE_ALIGN task_base: public ref_count_base<task_base, task
 	template<typename Sched>
 	void run_continuation(Sched& sched, task_ptr&& cont)
 	{
+		LIBASYNC_PROBE2(continuation_dispatch, this, cont.get());
 		LIBASYNC_TRY {
 			detail::schedule_task(sched, cont);
 		} LIBASYNC_CATCH(...) {
@@ -111,6 +120,7 @@ struct LIBASYNC_CACHELINE_ALIGN task_base: public ref_count_base<task_base, task
 	void run_continuations()
 	{
 		continuations.flush_and_lock([this](task_ptr t) {
+			LIBASYNC_PROBE2(continuation_dispatch, this, t.get());
 			const task_base_vtable* vtable_ptr = t->vtable;
 			vtable_ptr->schedule(this, std::move(t));
 		});
@@ -62,6 +62,19 @@
 # define HAVE_THREAD_SAFE_STATIC
 #endif
 
+// The vectorized reduction kernels use AVX2 through function-level target
+// attributes and select the implementation at runtime, so the library itself
+// doesn't need to be compiled with -mavx2. This requires GCC or Clang on x86.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define HAVE_AVX2_DISPATCH
+#endif
+
+// Non-temporal stores for large memory copies and fills. SSE2 is always
+// available on x86-64, so we only use them when the compiler enables it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define HAVE_STREAMING_STORES
+#endif
+
 // MSVC deadlocks when joining a thread from a static destructor. Use a
 // workaround in that case to avoid the deadlock.
 #if defined(_MSC_VER) && _MSC_VER < 1900
@@ -93,3 +106,4 @@
 #include "task_wait_event.h"
 #include "fifo_queue.h"
 #include "work_steal_queue.h"
+#include "scratch_arena.h"
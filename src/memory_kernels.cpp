@@ -0,0 +1,106 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "internal.h"
+
+#ifdef HAVE_STREAMING_STORES
+# include <emmintrin.h>
+#endif
+
+namespace async {
+namespace detail {
+
+void stream_copy(void* dst, const void* src, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	char* out = static_cast<char*>(dst);
+	const char* in = static_cast<const char*>(src);
+
+#ifdef HAVE_STREAMING_STORES
+	// Copy the first few bytes normally so that the destination is aligned
+	std::size_t head = (0 - reinterpret_cast<std::uintptr_t>(out)) & 15;
+	if (head > length)
+		head = length;
+	std::memcpy(out, in, head);
+	out += head;
+	in += head;
+	length -= head;
+
+	// Write full cache lines with non-temporal stores, which go straight to
+	// memory instead of evicting useful data from the cache.
+	for (; length >= 64; length -= 64, in += 64, out += 64) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 48), d);
+	}
+	for (; length >= 16; length -= 16, in += 16, out += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+
+	// Non-temporal stores are weakly ordered, make sure they are visible to
+	// other threads before returning.
+	_mm_sfence();
+#endif
+
+	std::memcpy(out, in, length);
+}
+
+void stream_fill(void* dst, std::size_t length, const void* pattern, std::size_t pattern_size) LIBASYNC_NOEXCEPT
+{
+	char* out = static_cast<char*>(dst);
+
+	// Repeat the pattern over 16 bytes. Since the destination is aligned to
+	// the pattern size, every 16-byte aligned address starts a new pattern.
+	char block[16];
+	for (std::size_t i = 0; i < 16; i += pattern_size)
+		std::memcpy(block + i, pattern, pattern_size);
+
+#ifdef HAVE_STREAMING_STORES
+	std::size_t head = (0 - reinterpret_cast<std::uintptr_t>(out)) & 15;
+	if (head > length)
+		head = length;
+	std::memcpy(out, block, head);
+	out += head;
+	length -= head;
+
+	__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+	for (; length >= 64; length -= 64, out += 64) {
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 16), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 32), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 48), value);
+	}
+	for (; length >= 16; length -= 16, out += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), value);
+	_mm_sfence();
+#else
+	for (; length >= 16; length -= 16, out += 16)
+		std::memcpy(out, block, 16);
+#endif
+
+	std::memcpy(out, block, length);
+}
+
+} // namespace detail
+} // namespace async
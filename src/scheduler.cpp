@@ -124,9 +124,68 @@ static wait_handler get_thread_wait_handler()
 #endif
 }
 
+#if defined(EMULATE_PTHREAD_THREAD_LOCAL)
+// Task tag, per-thread, defaults to 0
+struct pthread_emulation_thread_task_tag_key_initializer {
+	pthread_key_t key;
+
+	pthread_emulation_thread_task_tag_key_initializer()
+	{
+		pthread_key_create(&key, nullptr);
+	}
+
+	~pthread_emulation_thread_task_tag_key_initializer()
+	{
+		pthread_key_delete(key);
+	}
+};
+
+static pthread_key_t get_thread_task_tag_key()
+{
+	static pthread_emulation_thread_task_tag_key_initializer initializer;
+	return initializer.key;
+}
+#else
+static THREAD_LOCAL task_tag thread_task_tag = 0;
+#endif
+
+static void set_thread_task_tag(task_tag tag)
+{
+#if defined(EMULATE_PTHREAD_THREAD_LOCAL)
+	pthread_setspecific(get_thread_task_tag_key(), reinterpret_cast<void*>(tag));
+#else
+	thread_task_tag = tag;
+#endif
+}
+
+static task_tag get_thread_task_tag()
+{
+#if defined(EMULATE_PTHREAD_THREAD_LOCAL)
+	return reinterpret_cast<task_tag>(pthread_getspecific(get_thread_task_tag_key()));
+#else
+	return thread_task_tag;
+#endif
+}
+
+std::atomic<task_observer*> registered_task_observer(nullptr);
+
+void run_observed_task(task_observer* observer, task_base* t)
+{
+	// Tasks never let exceptions escape from run, so the tag can be restored
+	// without a guard.
+	task_tag old_tag = get_thread_task_tag();
+	set_thread_task_tag(t->tag);
+	observer->on_run_begin(t, t->tag);
+	t->vtable->run(t);
+	observer->on_run_end(t, t->tag);
+	set_thread_task_tag(old_tag);
+}
+
 // Wait for a task to complete
 void wait_for_task(task_base* wait_task)
 {
+	LIBASYNC_PROBE1(task_wait, wait_task);
+
 	// Dispatch to the current thread's wait handler
 	wait_handler thread_wait_handler = get_thread_wait_handler();
 	thread_wait_handler(task_wait_handle(wait_task));
@@ -238,6 +297,23 @@ wait_handler set_thread_wait_handler(wait_handler handler) LIBASYNC_NOEXCEPT
 	return old;
 }
 
+task_observer* set_task_observer(task_observer* observer) LIBASYNC_NOEXCEPT
+{
+	return detail::registered_task_observer.exchange(observer, std::memory_order_acq_rel);
+}
+
+task_tag current_task_tag() LIBASYNC_NOEXCEPT
+{
+	return detail::get_thread_task_tag();
+}
+
+task_tag set_current_task_tag(task_tag tag) LIBASYNC_NOEXCEPT
+{
+	task_tag old = detail::get_thread_task_tag();
+	detail::set_thread_task_tag(tag);
+	return old;
+}
+
 } // namespace async
 
 #ifndef LIBASYNC_STATIC
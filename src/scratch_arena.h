@@ -0,0 +1,95 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef ASYNCXX_H_
+# error "Do not include this header directly, include <async++.h> instead."
+#endif
+
+namespace async {
+namespace detail {
+
+// Bump-pointer allocator for temporary memory used by tasks. Memory is carved
+// out of a list of blocks which are kept when the arena is reset, so once the
+// arena has grown to the working set size no more memory is allocated.
+class scratch_arena {
+	struct block {
+		std::unique_ptr<char[]> data;
+		std::size_t size;
+	};
+
+	// Size of the first block, later blocks double in size
+	static const std::size_t initial_block_size = 64 << 10;
+
+	std::vector<block> blocks;
+	std::size_t current_block;
+	std::size_t offset;
+
+	// Try to allocate from the current block
+	void* try_alloc(std::size_t size, std::size_t align)
+	{
+		block& b = blocks[current_block];
+		std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.data.get());
+		std::uintptr_t addr = (base + offset + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+		if (addr + size > base + b.size)
+			return nullptr;
+		offset = addr + size - base;
+		return reinterpret_cast<void*>(addr);
+	}
+
+public:
+	scratch_arena()
+		: current_block(0), offset(0) {}
+
+	// Allocate memory with the given power of 2 alignment
+	void* alloc(std::size_t size, std::size_t align)
+	{
+		if (!blocks.empty()) {
+			if (void* ptr = try_alloc(size, align))
+				return ptr;
+
+			// Move on to the next existing block that is big enough, if any
+			while (current_block + 1 < blocks.size()) {
+				current_block++;
+				offset = 0;
+				if (void* ptr = try_alloc(size, align))
+					return ptr;
+			}
+		}
+
+		// Allocate a new block
+		std::size_t block_size = blocks.empty() ? initial_block_size : blocks.back().size * 2;
+		if (block_size < size + align)
+			block_size = size + align;
+		blocks.push_back(block{std::unique_ptr<char[]>(new char[block_size]), block_size});
+		current_block = blocks.size() - 1;
+		offset = 0;
+		return try_alloc(size, align);
+	}
+
+	// Release all allocations, keeping the blocks for reuse
+	void reset()
+	{
+		current_block = 0;
+		offset = 0;
+	}
+};
+
+} // namespace detail
+} // namespace async
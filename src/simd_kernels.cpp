@@ -0,0 +1,340 @@
+// Copyright (c) 2015 Amanieu d'Antras
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "internal.h"
+
+#ifdef HAVE_AVX2_DISPATCH
+# include <immintrin.h>
+#endif
+
+namespace async {
+namespace detail {
+namespace {
+
+// Portable kernels, used for short arrays and the tails of the vectorized
+// kernels. Using several independent
+// accumulators breaks the dependency chain between iterations, which allows
+// the compiler to pipeline and vectorize the loops.
+template<typename T>
+T scalar_sum(const T* data, std::size_t length)
+{
+	T acc[4] = {};
+	std::size_t i = 0;
+	for (; i + 4 <= length; i += 4) {
+		acc[0] += data[i];
+		acc[1] += data[i + 1];
+		acc[2] += data[i + 2];
+		acc[3] += data[i + 3];
+	}
+	for (; i < length; i++)
+		acc[0] += data[i];
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+template<typename T>
+void scalar_minmax(const T* data, std::size_t length, T& min, T& max)
+{
+	T lo = data[0];
+	T hi = data[0];
+	for (std::size_t i = 1; i < length; i++) {
+		lo = data[i] < lo ? data[i] : lo;
+		hi = hi < data[i] ? data[i] : hi;
+	}
+	min = lo;
+	max = hi;
+}
+
+template<typename T>
+T scalar_dot(const T* a, const T* b, std::size_t length)
+{
+	T acc[4] = {};
+	std::size_t i = 0;
+	for (; i + 4 <= length; i += 4) {
+		acc[0] += a[i] * b[i];
+		acc[1] += a[i + 1] * b[i + 1];
+		acc[2] += a[i + 2] * b[i + 2];
+		acc[3] += a[i + 3] * b[i + 3];
+	}
+	for (; i < length; i++)
+		acc[0] += a[i] * b[i];
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+// Number of elements in a vector of the AVX2 kernels below
+template<typename T>
+struct avx2_lanes: public std::integral_constant<std::size_t, 32 / sizeof(T)> {};
+
+// Portable versions of the AVX2 sum and dot product kernels, which accumulate
+// the elements in exactly the same order: 4 vectors of accumulators, combined
+// lane by lane and then with scalar_sum, followed by the scalar kernel for the
+// tail. This way floating point results are the same whether or not the CPU
+// supports AVX2, and the compiler can still vectorize the loops.
+template<typename T>
+T striped_sum(const T* data, std::size_t length)
+{
+	const std::size_t lanes = avx2_lanes<T>::value;
+	T acc[4][lanes] = {};
+	std::size_t i = 0;
+	for (; i + 4 * lanes <= length; i += 4 * lanes) {
+		for (std::size_t j = 0; j < 4; j++) {
+			for (std::size_t k = 0; k < lanes; k++)
+				acc[j][k] += data[i + j * lanes + k];
+		}
+	}
+	for (; i + lanes <= length; i += lanes) {
+		for (std::size_t k = 0; k < lanes; k++)
+			acc[0][k] += data[i + k];
+	}
+	T lane_sums[lanes];
+	for (std::size_t k = 0; k < lanes; k++)
+		lane_sums[k] = (acc[0][k] + acc[1][k]) + (acc[2][k] + acc[3][k]);
+	return scalar_sum(lane_sums, lanes) + scalar_sum(data + i, length - i);
+}
+
+template<typename T>
+T striped_dot(const T* a, const T* b, std::size_t length)
+{
+	const std::size_t lanes = avx2_lanes<T>::value;
+	T acc[4][lanes] = {};
+	std::size_t i = 0;
+	for (; i + 4 * lanes <= length; i += 4 * lanes) {
+		for (std::size_t j = 0; j < 4; j++) {
+			for (std::size_t k = 0; k < lanes; k++)
+				acc[j][k] += a[i + j * lanes + k] * b[i + j * lanes + k];
+		}
+	}
+	for (; i + lanes <= length; i += lanes) {
+		for (std::size_t k = 0; k < lanes; k++)
+			acc[0][k] += a[i + k] * b[i + k];
+	}
+	T lane_sums[lanes];
+	for (std::size_t k = 0; k < lanes; k++)
+		lane_sums[k] = (acc[0][k] + acc[1][k]) + (acc[2][k] + acc[3][k]);
+	return scalar_sum(lane_sums, lanes) + scalar_dot(a + i, b + i, length - i);
+}
+
+#ifdef HAVE_AVX2_DISPATCH
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// Check once whether the CPU and OS support AVX2
+bool have_avx2()
+{
+	static const bool result = [] {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+	}();
+	return result;
+}
+
+// Wrappers around the AVX2 intrinsics for each element type, so that the
+// kernels only need to be written once.
+struct avx2_float {
+	typedef float value_type;
+	typedef __m256 vec;
+	static const std::size_t lanes = 8;
+	static AVX2_TARGET vec zero() { return _mm256_setzero_ps(); }
+	static AVX2_TARGET vec load(const float* p) { return _mm256_loadu_ps(p); }
+	static AVX2_TARGET void store(float* p, vec x) { _mm256_storeu_ps(p, x); }
+	static AVX2_TARGET vec add(vec x, vec y) { return _mm256_add_ps(x, y); }
+	static AVX2_TARGET vec mul(vec x, vec y) { return _mm256_mul_ps(x, y); }
+	static AVX2_TARGET vec min(vec x, vec y) { return _mm256_min_ps(x, y); }
+	static AVX2_TARGET vec max(vec x, vec y) { return _mm256_max_ps(x, y); }
+};
+struct avx2_double {
+	typedef double value_type;
+	typedef __m256d vec;
+	static const std::size_t lanes = 4;
+	static AVX2_TARGET vec zero() { return _mm256_setzero_pd(); }
+	static AVX2_TARGET vec load(const double* p) { return _mm256_loadu_pd(p); }
+	static AVX2_TARGET void store(double* p, vec x) { _mm256_storeu_pd(p, x); }
+	static AVX2_TARGET vec add(vec x, vec y) { return _mm256_add_pd(x, y); }
+	static AVX2_TARGET vec mul(vec x, vec y) { return _mm256_mul_pd(x, y); }
+	static AVX2_TARGET vec min(vec x, vec y) { return _mm256_min_pd(x, y); }
+	static AVX2_TARGET vec max(vec x, vec y) { return _mm256_max_pd(x, y); }
+};
+struct avx2_int {
+	typedef int value_type;
+	typedef __m256i vec;
+	static const std::size_t lanes = 8;
+	static AVX2_TARGET vec zero() { return _mm256_setzero_si256(); }
+	static AVX2_TARGET vec load(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static AVX2_TARGET void store(int* p, vec x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+	static AVX2_TARGET vec add(vec x, vec y) { return _mm256_add_epi32(x, y); }
+	static AVX2_TARGET vec mul(vec x, vec y) { return _mm256_mullo_epi32(x, y); }
+	static AVX2_TARGET vec min(vec x, vec y) { return _mm256_min_epi32(x, y); }
+	static AVX2_TARGET vec max(vec x, vec y) { return _mm256_max_epi32(x, y); }
+};
+
+// The main loops process 4 vectors per iteration with separate accumulators to
+// hide the latency of the vector additions. The remaining elements are handled
+// by the scalar kernels.
+template<typename V>
+AVX2_TARGET typename V::value_type avx2_sum(const typename V::value_type* data, std::size_t length)
+{
+	typedef typename V::value_type T;
+	static_assert(V::lanes == avx2_lanes<T>::value, "Lane count must match the portable kernel");
+	typename V::vec acc0 = V::zero(), acc1 = V::zero(), acc2 = V::zero(), acc3 = V::zero();
+	std::size_t i = 0;
+	for (; i + 4 * V::lanes <= length; i += 4 * V::lanes) {
+		acc0 = V::add(acc0, V::load(data + i));
+		acc1 = V::add(acc1, V::load(data + i + V::lanes));
+		acc2 = V::add(acc2, V::load(data + i + 2 * V::lanes));
+		acc3 = V::add(acc3, V::load(data + i + 3 * V::lanes));
+	}
+	for (; i + V::lanes <= length; i += V::lanes)
+		acc0 = V::add(acc0, V::load(data + i));
+	T lanes[V::lanes];
+	V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+	return scalar_sum(lanes, V::lanes) + scalar_sum(data + i, length - i);
+}
+
+template<typename V>
+AVX2_TARGET void avx2_minmax(const typename V::value_type* data, std::size_t length, typename V::value_type& min, typename V::value_type& max)
+{
+	typedef typename V::value_type T;
+	if (length < V::lanes) {
+		scalar_minmax(data, length, min, max);
+		return;
+	}
+	typename V::vec lo = V::load(data), hi = lo;
+	std::size_t i = V::lanes;
+	for (; i + V::lanes <= length; i += V::lanes) {
+		typename V::vec x = V::load(data + i);
+		lo = V::min(lo, x);
+		hi = V::max(hi, x);
+	}
+
+	// Include the last (possibly overlapping) vector to handle the tail
+	typename V::vec x = V::load(data + length - V::lanes);
+	lo = V::min(lo, x);
+	hi = V::max(hi, x);
+	T lo_lanes[V::lanes], hi_lanes[V::lanes];
+	V::store(lo_lanes, lo);
+	V::store(hi_lanes, hi);
+	T unused;
+	scalar_minmax(lo_lanes, V::lanes, min, unused);
+	scalar_minmax(hi_lanes, V::lanes, unused, max);
+}
+
+template<typename V>
+AVX2_TARGET typename V::value_type avx2_dot(const typename V::value_type* a, const typename V::value_type* b, std::size_t length)
+{
+	typedef typename V::value_type T;
+	static_assert(V::lanes == avx2_lanes<T>::value, "Lane count must match the portable kernel");
+	typename V::vec acc0 = V::zero(), acc1 = V::zero(), acc2 = V::zero(), acc3 = V::zero();
+	std::size_t i = 0;
+	for (; i + 4 * V::lanes <= length; i += 4 * V::lanes) {
+		acc0 = V::add(acc0, V::mul(V::load(a + i), V::load(b + i)));
+		acc1 = V::add(acc1, V::mul(V::load(a + i + V::lanes), V::load(b + i + V::lanes)));
+		acc2 = V::add(acc2, V::mul(V::load(a + i + 2 * V::lanes), V::load(b + i + 2 * V::lanes)));
+		acc3 = V::add(acc3, V::mul(V::load(a + i + 3 * V::lanes), V::load(b + i + 3 * V::lanes)));
+	}
+	for (; i + V::lanes <= length; i += V::lanes)
+		acc0 = V::add(acc0, V::mul(V::load(a + i), V::load(b + i)));
+	T lanes[V::lanes];
+	V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+	return scalar_sum(lanes, V::lanes) + scalar_dot(a + i, b + i, length - i);
+}
+
+#else
+
+// Dummy vector types so that the dispatch functions can be used unchanged
+struct avx2_float {};
+struct avx2_double {};
+struct avx2_int {};
+
+#endif
+
+// Select the best available implementation of each kernel
+template<typename V, typename T>
+T dispatch_sum(const T* data, std::size_t length)
+{
+#ifdef HAVE_AVX2_DISPATCH
+	if (have_avx2())
+		return avx2_sum<V>(data, length);
+#endif
+	return striped_sum(data, length);
+}
+
+template<typename V, typename T>
+void dispatch_minmax(const T* data, std::size_t length, T& min, T& max)
+{
+#ifdef HAVE_AVX2_DISPATCH
+	if (have_avx2())
+		return avx2_minmax<V>(data, length, min, max);
+#endif
+	scalar_minmax(data, length, min, max);
+}
+
+template<typename V, typename T>
+T dispatch_dot(const T* a, const T* b, std::size_t length)
+{
+#ifdef HAVE_AVX2_DISPATCH
+	if (have_avx2())
+		return avx2_dot<V>(a, b, length);
+#endif
+	return striped_dot(a, b, length);
+}
+
+} // namespace
+
+float simd_sum(const float* data, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_sum<avx2_float>(data, length);
+}
+double simd_sum(const double* data, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_sum<avx2_double>(data, length);
+}
+int simd_sum(const int* data, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_sum<avx2_int>(data, length);
+}
+
+void simd_minmax(const float* data, std::size_t length, float& min, float& max) LIBASYNC_NOEXCEPT
+{
+	dispatch_minmax<avx2_float>(data, length, min, max);
+}
+void simd_minmax(const double* data, std::size_t length, double& min, double& max) LIBASYNC_NOEXCEPT
+{
+	dispatch_minmax<avx2_double>(data, length, min, max);
+}
+void simd_minmax(const int* data, std::size_t length, int& min, int& max) LIBASYNC_NOEXCEPT
+{
+	dispatch_minmax<avx2_int>(data, length, min, max);
+}
+
+float simd_dot(const float* a, const float* b, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_dot<avx2_float>(a, b, length);
+}
+double simd_dot(const double* a, const double* b, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_dot<avx2_double>(a, b, length);
+}
+int simd_dot(const int* a, const int* b, std::size_t length) LIBASYNC_NOEXCEPT
+{
+	return dispatch_dot<avx2_int>(a, b, length);
+}
+
+} // namespace detail
+} // namespace async
@@ -33,22 +33,103 @@
 namespace async {
 namespace detail {
 
+#ifdef LIBASYNC_TASK_TIMING
+// Histogram which is only updated by the thread that owns it. Relaxed atomic
+// loads and stores avoid data races with readers, without the cost of atomic
+// read-modify-write operations.
+struct thread_latency_histogram {
+	std::atomic<std::uint64_t> buckets[latency_histogram::num_buckets];
+	std::atomic<std::uint64_t> count;
+	std::atomic<std::uint64_t> total_ns;
+
+	thread_latency_histogram()
+	{
+		reset();
+	}
+
+	static void increment(std::atomic<std::uint64_t>& x, std::uint64_t value)
+	{
+		x.store(x.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void record(std::uint64_t ns)
+	{
+		std::size_t bucket = 0;
+		for (std::uint64_t x = ns >> 1; x && bucket < latency_histogram::num_buckets - 1; x >>= 1)
+			bucket++;
+		increment(buckets[bucket], 1);
+		increment(count, 1);
+		increment(total_ns, ns);
+	}
+
+	// Add the contents of this histogram to another one
+	void merge_into(latency_histogram& out) const
+	{
+		for (std::size_t i = 0; i < latency_histogram::num_buckets; i++)
+			out.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+		out.count += count.load(std::memory_order_relaxed);
+		out.total_ns += total_ns.load(std::memory_order_relaxed);
+	}
+
+	void reset()
+	{
+		for (std::size_t i = 0; i < latency_histogram::num_buckets; i++)
+			buckets[i].store(0, std::memory_order_relaxed);
+		count.store(0, std::memory_order_relaxed);
+		total_ns.store(0, std::memory_order_relaxed);
+	}
+};
+#endif
+
 // Per-thread data, aligned to cachelines to avoid false sharing
 struct LIBASYNC_CACHELINE_ALIGN thread_data_t {
+	thread_data_t()
+		: mailbox_size(0), pinned_mailbox_size(0), waiting_event(nullptr) {}
+
 	work_steal_queue queue;
 	std::minstd_rand rng;
 	std::thread handle;
+
+	// Tasks scheduled specifically for this thread using schedule_on(). The
+	// mailbox is protected by the thread pool lock, but mailbox_size can be
+	// read outside the lock to avoid locking when the mailbox is empty.
+	fifo_queue mailbox;
+	std::atomic<std::size_t> mailbox_size;
+
+	// Tasks which must run on this thread, used by run_on_all_workers(). This
+	// works like the mailbox, except that other threads never take tasks from
+	// it.
+	fifo_queue pinned_mailbox;
+	std::atomic<std::size_t> pinned_mailbox_size;
+
+	// Event this thread is sleeping on, or null if it is awake. This is
+	// protected by the thread pool lock.
+	task_wait_event* waiting_event;
+
+	// Scratch memory for tasks running on this thread, reset after each
+	// top-level task.
+	scratch_arena scratch;
+
+#ifdef LIBASYNC_TASK_TIMING
+	// Timing of the tasks run by this thread
+	thread_latency_histogram queue_delay;
+	thread_latency_histogram run_time;
+	thread_latency_histogram end_to_end;
+#endif
 };
 
 // Internal data used by threadpool_scheduler
 struct threadpool_data {
-	threadpool_data(std::size_t num_threads)
-		: thread_data(num_threads), shutdown(false), num_waiters(0), waiters(new task_wait_event*[num_threads]) {}
+	threadpool_data(threadpool_scheduler* owner_, std::size_t num_threads)
+		: owner(owner_), thread_data(num_threads), shutdown(false), num_waiters(0), waiters(new task_wait_event*[num_threads]) {}
 
-    threadpool_data(std::size_t num_threads, std::function<void()>&& prerun_, std::function<void()>&& postrun_)
-		: thread_data(num_threads), shutdown(false), num_waiters(0), waiters(new task_wait_event*[num_threads]),
+    threadpool_data(threadpool_scheduler* owner_, std::size_t num_threads, std::function<void()>&& prerun_, std::function<void()>&& postrun_)
+		: owner(owner_), thread_data(num_threads), shutdown(false), num_waiters(0), waiters(new task_wait_event*[num_threads]),
           prerun(std::move(prerun_)), postrun(std::move(postrun_)) {}
 
+	// Scheduler object which owns this data, updated when it is moved
+	std::atomic<threadpool_scheduler*> owner;
+
 	// Mutex protecting everything except thread_data
 	std::mutex lock;
 
@@ -145,6 +226,58 @@ static threadpool_data_wrapper get_threadpool_data_wrapper()
 #endif
 }
 
+// Pop a task from a thread's mailbox. The thread pool lock must be held.
+static task_run_handle pop_mailbox_locked(thread_data_t& data)
+{
+	task_run_handle t = data.mailbox.pop();
+	if (t)
+		data.mailbox_size.store(data.mailbox_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+	return t;
+}
+
+// Pop a task from a thread's mailbox, only taking the lock if it isn't empty
+static task_run_handle pop_mailbox(threadpool_data* impl, std::size_t thread_id)
+{
+	thread_data_t& data = impl->thread_data[thread_id];
+	if (data.mailbox_size.load(std::memory_order_relaxed) == 0)
+		return task_run_handle();
+	std::lock_guard<std::mutex> locked(impl->lock);
+	return pop_mailbox_locked(data);
+}
+
+// Same as above, for the pinned mailbox
+static task_run_handle pop_pinned_mailbox_locked(thread_data_t& data)
+{
+	task_run_handle t = data.pinned_mailbox.pop();
+	if (t)
+		data.pinned_mailbox_size.store(data.pinned_mailbox_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+	return t;
+}
+static task_run_handle pop_pinned_mailbox(threadpool_data* impl, std::size_t thread_id)
+{
+	thread_data_t& data = impl->thread_data[thread_id];
+	if (data.pinned_mailbox_size.load(std::memory_order_relaxed) == 0)
+		return task_run_handle();
+	std::lock_guard<std::mutex> locked(impl->lock);
+	return pop_pinned_mailbox_locked(data);
+}
+
+// Remove a sleeping thread from the list of waiters and wake it up. The
+// thread pool lock must be held.
+static void wake_waiting_thread(threadpool_data* impl, task_wait_event* event)
+{
+	size_t num_waiters_val = impl->num_waiters.load(std::memory_order_relaxed);
+	for (std::size_t i = 0; i < num_waiters_val; i++) {
+		if (impl->waiters[i] == event) {
+			if (i != num_waiters_val - 1)
+				std::swap(impl->waiters[i], impl->waiters[num_waiters_val - 1]);
+			impl->num_waiters.store(num_waiters_val - 1, std::memory_order_relaxed);
+			event->signal(wait_type::task_available);
+			return;
+		}
+	}
+}
+
 // Try to steal a task from another thread's queue
 static task_run_handle steal_task(threadpool_data* impl, std::size_t thread_id)
 {
@@ -159,16 +292,45 @@ static task_run_handle steal_task(threadpool_data* impl, std::size_t thread_id)
 		if (i == thread_id)
 			continue;
 
-		if (task_run_handle t = impl->thread_data[i].queue.steal())
+		if (task_run_handle t = impl->thread_data[i].queue.steal()) {
+			LIBASYNC_PROBE2(steal, thread_id, i);
+			if (task_observer* observer = get_task_observer())
+				observer->on_steal(thread_id, i);
+			return t;
+		}
+	}
+
+	// Tasks in other threads' mailboxes are meant to run on those threads,
+	// but take them anyway rather than staying idle.
+	for (std::size_t i: victims) {
+		if (i == thread_id)
+			continue;
+
+		if (task_run_handle t = pop_mailbox(impl, i)) {
+			LIBASYNC_PROBE2(steal, thread_id, i);
+			if (task_observer* observer = get_task_observer())
+				observer->on_steal(thread_id, i);
 			return t;
+		}
 	}
 
 	// No tasks found, but we might have missed one if it was just added. In
 	// practice this doesn't really matter since it will be handled by another
 	// thread.
+	LIBASYNC_PROBE1(steal_fail, thread_id);
 	return task_run_handle();
 }
 
+// Run a task from the task loop. Tasks run from the main loop of a worker are
+// top-level tasks, and nothing can still be using the scratch arena once they
+// have finished.
+static void run_task(thread_data_t& current_thread, task_run_handle t, bool top_level)
+{
+	t.run();
+	if (top_level)
+		current_thread.scratch.reset();
+}
+
 // Main task stealing loop which is used by worker threads when they have
 // nothing to do.
 static void thread_task_loop(threadpool_data* impl, std::size_t thread_id, task_wait_handle wait_task)
@@ -192,7 +354,17 @@ static void thread_task_loop(threadpool_data* impl, std::size_t thread_id, task_
 
 		// Try to get a task from the local queue
 		if (task_run_handle t = current_thread.queue.pop()) {
-			t.run();
+			run_task(current_thread, std::move(t), !wait_task);
+			continue;
+		}
+
+		// Try to get a task which was scheduled specifically for this thread
+		if (task_run_handle t = pop_pinned_mailbox(impl, thread_id)) {
+			run_task(current_thread, std::move(t), !wait_task);
+			continue;
+		}
+		if (task_run_handle t = pop_mailbox(impl, thread_id)) {
+			run_task(current_thread, std::move(t), !wait_task);
 			continue;
 		}
 
@@ -200,16 +372,29 @@ static void thread_task_loop(threadpool_data* impl, std::size_t thread_id, task_
 		while (true) {
 			// Try to steal a task
 			if (task_run_handle t = steal_task(impl, thread_id)) {
-				t.run();
+				run_task(current_thread, std::move(t), !wait_task);
 				break;
 			}
 
-			// Try to fetch from the public queue
+			// Check our mailbox again while holding the lock, since
+			// schedule_on() won't wake us up if we aren't sleeping yet.
 			std::unique_lock<std::mutex> locked(impl->lock);
+			if (task_run_handle t = pop_pinned_mailbox_locked(current_thread)) {
+				locked.unlock();
+				run_task(current_thread, std::move(t), !wait_task);
+				break;
+			}
+			if (task_run_handle t = pop_mailbox_locked(current_thread)) {
+				locked.unlock();
+				run_task(current_thread, std::move(t), !wait_task);
+				break;
+			}
+
+			// Try to fetch from the public queue
 			if (task_run_handle t = impl->public_queue.pop()) {
 				// Don't hold the lock while running the task
 				locked.unlock();
-				t.run();
+				run_task(current_thread, std::move(t), !wait_task);
 				break;
 			}
 
@@ -241,12 +426,20 @@ static void thread_task_loop(threadpool_data* impl, std::size_t thread_id, task_
 			size_t num_waiters_val = impl->num_waiters.load(std::memory_order_relaxed);
 			impl->waiters[num_waiters_val] = &event;
 			impl->num_waiters.store(num_waiters_val + 1, std::memory_order_relaxed);
+			current_thread.waiting_event = &event;
 
 			// Wait for our event to be signaled when a task is scheduled or
 			// the task we are waiting for has completed.
 			locked.unlock();
+			LIBASYNC_PROBE1(worker_park, thread_id);
+			if (task_observer* observer = get_task_observer())
+				observer->on_park(thread_id);
 			int events = event.wait();
+			LIBASYNC_PROBE2(worker_unpark, thread_id, events);
+			if (task_observer* observer = get_task_observer())
+				observer->on_unpark(thread_id);
 			locked.lock();
+			current_thread.waiting_event = nullptr;
 
 			// Remove our thread from the list of waiting threads
 			num_waiters_val = impl->num_waiters.load(std::memory_order_relaxed);
@@ -323,10 +516,14 @@ static void recursive_spawn_worker_thread(threadpool_data* impl, std::size_t ind
 } // namespace detail
 
 threadpool_scheduler::threadpool_scheduler(threadpool_scheduler&& other)
-        : impl(std::move(other.impl)) {}
+        : impl(std::move(other.impl))
+{
+	if (impl)
+		impl->owner.store(this, std::memory_order_release);
+}
 
 threadpool_scheduler::threadpool_scheduler(std::size_t num_threads)
-	: impl(new detail::threadpool_data(num_threads))
+	: impl(new detail::threadpool_data(this, num_threads))
 {
 	// Start worker threads
 	impl->thread_data[0].handle = std::thread(detail::recursive_spawn_worker_thread, impl.get(), 0, num_threads);
@@ -338,7 +535,7 @@ threadpool_scheduler::threadpool_scheduler(std::size_t num_threads)
 threadpool_scheduler::threadpool_scheduler(std::size_t num_threads,
                                            std::function<void()>&& prerun,
                                            std::function<void()>&& postrun)
-    : impl(new detail::threadpool_data(num_threads, std::move(prerun), std::move(postrun)))
+    : impl(new detail::threadpool_data(this, num_threads, std::move(prerun), std::move(postrun)))
 {
 	// Start worker threads
 	impl->thread_data[0].handle = std::thread(detail::recursive_spawn_worker_thread, impl.get(), 0, num_threads);
@@ -439,6 +636,174 @@ void threadpool_scheduler::schedule(task_run_handle t)
 	}
 }
 
+// Schedule a task on a specific thread of the thread pool
+void threadpool_scheduler::schedule_on(std::size_t thread, task_run_handle t)
+{
+	// Fall back to normal scheduling for an invalid thread index
+	if (thread >= impl->thread_data.size()) {
+		schedule(std::move(t));
+		return;
+	}
+
+	std::lock_guard<std::mutex> locked(impl->lock);
+
+	// Push the task into the thread's mailbox
+	detail::thread_data_t& target = impl->thread_data[thread];
+	target.mailbox.push(std::move(t));
+	target.mailbox_size.store(target.mailbox_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	// Wake up the thread if it is sleeping. If it is awake then it will check
+	// its mailbox before going to sleep, but it may be busy for a while, so
+	// wake up another sleeping thread like schedule() does. That thread only
+	// takes the task if it can't find anything to steal from the task queues.
+	if (target.waiting_event) {
+		detail::wake_waiting_thread(impl.get(), target.waiting_event);
+		return;
+	}
+	size_t num_waiters_val = impl->num_waiters.load(std::memory_order_relaxed);
+	if (num_waiters_val == 0)
+		return;
+	impl->waiters[num_waiters_val - 1]->signal(detail::wait_type::task_available);
+	impl->num_waiters.store(num_waiters_val - 1, std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// Scheduler which places tasks in the pinned mailbox of a thread
+struct pinned_scheduler {
+	threadpool_data* impl;
+	std::size_t thread;
+
+	void schedule(task_run_handle t)
+	{
+		std::lock_guard<std::mutex> locked(impl->lock);
+		thread_data_t& target = impl->thread_data[thread];
+		target.pinned_mailbox.push(std::move(t));
+		target.pinned_mailbox_size.store(target.pinned_mailbox_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (target.waiting_event)
+			wake_waiting_thread(impl, target.waiting_event);
+	}
+};
+
+} // namespace detail
+
+void threadpool_scheduler::run_on_all_workers(const std::function<void(std::size_t)>& func)
+{
+	std::size_t num = impl->thread_data.size();
+	std::vector<detail::pinned_scheduler> scheds(num);
+	std::vector<task<void>> tasks;
+	tasks.reserve(num);
+	for (std::size_t i = 0; i < num; i++) {
+		scheds[i].impl = impl.get();
+		scheds[i].thread = i;
+		tasks.push_back(async::spawn(scheds[i], [&func, i] {
+			func(i);
+		}));
+	}
+
+	// Wait for all calls to finish before rethrowing any exception, since the
+	// calls use func by reference.
+	for (task<void>& t: tasks)
+		t.wait();
+	for (task<void>& t: tasks)
+		t.get();
+}
+
+std::size_t threadpool_scheduler::num_threads() const
+{
+	return impl->thread_data.size();
+}
+
+task_timing_stats threadpool_scheduler::task_timing() const
+{
+	task_timing_stats out;
+#ifdef LIBASYNC_TASK_TIMING
+	for (std::size_t i = 0; i < impl->thread_data.size(); i++) {
+		impl->thread_data[i].queue_delay.merge_into(out.queue_delay);
+		impl->thread_data[i].run_time.merge_into(out.run_time);
+		impl->thread_data[i].end_to_end.merge_into(out.end_to_end);
+	}
+#endif
+	return out;
+}
+
+void threadpool_scheduler::reset_task_timing()
+{
+#ifdef LIBASYNC_TASK_TIMING
+	for (std::size_t i = 0; i < impl->thread_data.size(); i++) {
+		impl->thread_data[i].queue_delay.reset();
+		impl->thread_data[i].run_time.reset();
+		impl->thread_data[i].end_to_end.reset();
+	}
+#endif
+}
+
+namespace detail {
+
+std::size_t current_thread_index() LIBASYNC_NOEXCEPT
+{
+	threadpool_data_wrapper wrapper = get_threadpool_data_wrapper();
+	return wrapper.owning_threadpool ? wrapper.thread_id : invalid_thread_index;
+}
+
+threadpool_data* current_threadpool() LIBASYNC_NOEXCEPT
+{
+	return get_threadpool_data_wrapper().owning_threadpool;
+}
+
+std::size_t threadpool_num_threads(const threadpool_data* pool) LIBASYNC_NOEXCEPT
+{
+	return pool->thread_data.size();
+}
+
+#ifdef LIBASYNC_TASK_TIMING
+void record_task_timing(std::uint64_t schedule_time, std::uint64_t start_time, std::uint64_t end_time) LIBASYNC_NOEXCEPT
+{
+	threadpool_data_wrapper wrapper = get_threadpool_data_wrapper();
+	if (!wrapper.owning_threadpool)
+		return;
+	thread_data_t& data = wrapper.owning_threadpool->thread_data[wrapper.thread_id];
+	data.queue_delay.record(start_time - schedule_time);
+	data.run_time.record(end_time - start_time);
+	data.end_to_end.record(end_time - schedule_time);
+}
+#endif
+
+// Other threads are only worth feeding if they are asleep waiting for tasks and
+// there are no tasks left in our queue for them to steal.
+bool pool_is_hungry() LIBASYNC_NOEXCEPT
+{
+	threadpool_data_wrapper wrapper = get_threadpool_data_wrapper();
+	threadpool_data* impl = wrapper.owning_threadpool;
+	if (!impl)
+		return false;
+	return impl->thread_data[wrapper.thread_id].queue.empty() && impl->num_waiters.load(std::memory_order_relaxed) != 0;
+}
+
+} // namespace detail
+
+namespace this_worker {
+
+std::size_t index() LIBASYNC_NOEXCEPT
+{
+	return detail::current_thread_index();
+}
+
+threadpool_scheduler* pool() LIBASYNC_NOEXCEPT
+{
+	detail::threadpool_data* impl = detail::current_threadpool();
+	return impl ? impl->owner.load(std::memory_order_acquire) : nullptr;
+}
+
+void* scratch_alloc(std::size_t size, std::size_t align)
+{
+	detail::threadpool_data_wrapper wrapper = detail::get_threadpool_data_wrapper();
+	if (!wrapper.owning_threadpool)
+		return nullptr;
+	return wrapper.owning_threadpool->thread_data[wrapper.thread_id].scratch.alloc(size, align);
+}
+
+} // namespace this_worker
 } // namespace async
 
 #ifndef LIBASYNC_STATIC
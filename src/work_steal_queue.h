@@ -120,6 +120,15 @@ public:
 		bottom.store(b + 1, std::memory_order_relaxed);
 	}
 
+	// Check whether the queue is empty. This is only a hint since other threads
+	// may be stealing from the queue concurrently.
+	bool empty() const
+	{
+		std::size_t b = bottom.load(std::memory_order_relaxed);
+		std::size_t t = top.load(std::memory_order_relaxed);
+		return to_signed(b - t) <= 0;
+	}
+
 	// Pop a task from the bottom of this thread's queue
 	task_run_handle pop()
 	{